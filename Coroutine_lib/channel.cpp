@@ -0,0 +1,84 @@
+/*
+ - File Name: channel.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Wed 28 Oct 2026 03:12:40 PM CST
+ */
+
+#include "channel.h"
+#include <algorithm>
+
+namespace Hourglass
+{
+int Select::tryOnce()
+{
+    for(size_t i = 0;i < m_cases.size();i++)
+    {
+	if(m_cases[i].attempt())
+	{
+	    return i;
+	}
+    }
+    return -1;
+}
+
+int Select::wait(std::chrono::nanoseconds timeout)
+{
+    WaitQueue::checkTimeout(timeout);
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while(true)
+    {
+	int index = tryOnce();
+	if(index >= 0 || m_cases.empty())
+	{
+	    return index;
+	}
+	std::shared_ptr<SyncWaiter> waiter = WaitQueue::prepare();
+	for(auto& c : m_cases)
+	{
+	    c.queue->enqueue(waiter);
+	}
+	// 登记之后再试一次，避免错过登记之前的通知
+	index = tryOnce();
+	bool notified = false;
+	if(index >= 0)
+	{
+	    // 已经登记过，可能同时被某个通道认领了，要把这次唤醒收掉
+	    notified = !WaitQueue::cancel(waiter.get());
+	    if(notified)
+	    {
+		WaitQueue::park(waiter,std::chrono::nanoseconds(-1));
+	    }
+	}
+	else
+	{
+	    std::chrono::nanoseconds left(-1);
+	    if(timeout.count() >= 0)
+	    {
+		left = std::max(deadline - std::chrono::steady_clock::now(),std::chrono::steady_clock::duration::zero());
+	    }
+	    notified = WaitQueue::park(waiter,left);
+	}
+	for(auto& c : m_cases)
+	{
+	    c.queue->remove(waiter.get());
+	}
+	if(index < 0 && notified)
+	{
+	    index = tryOnce();
+	}
+	if(notified)
+	{
+	    // 唤醒本等待者的通知不一定被用掉了（完成的是另一个分支），转给各通道上的其他等待者
+	    for(auto& c : m_cases)
+	    {
+		c.queue->wakeOne();
+	    }
+	}
+	if(index >= 0 || !notified)
+	{
+	    return index;
+	}
+    }
+}
+}
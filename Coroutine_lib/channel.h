@@ -0,0 +1,388 @@
+/*
+ - File Name: channel.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Wed 28 Oct 2026 10:36:52 AM CST
+ */
+
+#ifndef _CHANNEL_H_
+#define _CHANNEL_H_
+
+#include "sync.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace Hourglass
+{
+// 协程之间传递数据的有界MPMC通道．缓冲区是无锁环形队列（每个格子带序号），
+// 满时send、空时recv把当前协程挂到通道的等待队列上，另一端操作成功后唤醒一个等待者重试．
+// capacity为0时是无缓冲通道：用容量1的环实现，send在值被recv取走之后才返回；
+// trySend只在有挂起的接收方时成功，Select中的发送只能用于有缓冲的通道．
+// close之后send返回false，recv先取完缓冲区中剩下的值，之后返回false
+template <class T>
+class Channel
+{
+    friend class Select;
+
+private:
+    // 位置pos的格子空闲时seq为2*pos，放入值之后为2*pos+1，取走之后为2*(pos+capacity)，
+    // 乘2是为了容量为1时空闲与已放入两种状态不会重合
+    struct Cell
+    {
+	std::atomic<size_t> seq;
+	alignas(T) unsigned char storage[sizeof(T)];
+	T* value() {return reinterpret_cast<T*>(storage);}
+    };
+
+    const size_t m_capacity;
+    const bool m_unbuffered;
+    std::unique_ptr<Cell[]> m_cells;
+    // 生产者与消费者的位置分开放，避免伪共享
+    alignas(64) std::atomic<size_t> m_tail = {0};
+    alignas(64) std::atomic<size_t> m_head = {0};
+    std::atomic<bool> m_closed = {false};
+    WaitQueue m_sendq;
+    WaitQueue m_recvq;
+    // 无缓冲通道上等待值被取走的发送者
+    WaitQueue m_ackq;
+
+    // 放入成功才移走value，pos返回放入的位置
+    bool tryPush(T& value, size_t& pos)
+    {
+	pos = m_tail.load(std::memory_order_relaxed);
+	Cell* cell;
+	while(true)
+	{
+	    cell = &m_cells[pos % m_capacity];
+	    size_t seq = cell->seq.load(std::memory_order_acquire);
+	    intptr_t diff = (intptr_t)seq - (intptr_t)(2 * pos);
+	    if(diff == 0)
+	    {
+		if(m_tail.compare_exchange_weak(pos,pos + 1,std::memory_order_relaxed))
+		{
+		    break;
+		}
+	    }
+	    else if(diff < 0)
+	    {
+		return false;
+	    }
+	    else
+	    {
+		pos = m_tail.load(std::memory_order_relaxed);
+	    }
+	}
+	new (cell->storage) T(std::move(value));
+	cell->seq.store(2 * pos + 1,std::memory_order_release);
+	return true;
+    }
+
+    bool tryPop(T& out)
+    {
+	size_t pos = m_head.load(std::memory_order_relaxed);
+	Cell* cell;
+	while(true)
+	{
+	    cell = &m_cells[pos % m_capacity];
+	    size_t seq = cell->seq.load(std::memory_order_acquire);
+	    intptr_t diff = (intptr_t)seq - (intptr_t)(2 * pos + 1);
+	    if(diff == 0)
+	    {
+		if(m_head.compare_exchange_weak(pos,pos + 1,std::memory_order_relaxed))
+		{
+		    break;
+		}
+	    }
+	    else if(diff < 0)
+	    {
+		return false;
+	    }
+	    else
+	    {
+		pos = m_head.load(std::memory_order_relaxed);
+	    }
+	}
+	out = std::move(*cell->value());
+	cell->value()->~T();
+	cell->seq.store(2 * (pos + m_capacity),std::memory_order_release);
+	return true;
+    }
+
+    // 操作成功之后唤醒另一端的一个等待者，与等待者先登记再重试配对
+    static void notify(WaitQueue& queue)
+    {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	queue.wakeOne();
+    }
+
+    void afterPush()
+    {
+	notify(m_recvq);
+    }
+
+    void afterPop()
+    {
+	notify(m_sendq);
+	if(m_unbuffered)
+	{
+	    std::atomic_thread_fence(std::memory_order_seq_cst);
+	    m_ackq.wakeAll();
+	}
+    }
+
+public:
+    explicit Channel(size_t capacity = 0)
+	:m_capacity(capacity ? capacity : 1),m_unbuffered(capacity == 0),m_cells(new Cell[m_capacity])
+    {
+	for(size_t i = 0;i < m_capacity;i++)
+	{
+	    m_cells[i].seq.store(2 * i,std::memory_order_relaxed);
+	}
+    }
+
+    // 析构时不能再有协程在使用通道
+    ~Channel()
+    {
+	size_t tail = m_tail.load();
+	for(size_t pos = m_head.load();pos < tail;pos++)
+	{
+	    m_cells[pos % m_capacity].value()->~T();
+	}
+    }
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    // 通道已满时挂起，关闭时返回false
+    bool send(T value)
+    {
+	size_t pos = 0;
+	bool pushed = false;
+	auto attempt = [&]()
+	{
+	    if(m_closed.load())
+	    {
+		return true;
+	    }
+	    pushed = tryPush(value,pos);
+	    return pushed;
+	};
+	while(!attempt())
+	{
+	    if(m_sendq.wait(attempt,std::chrono::nanoseconds(-1)) == WaitQueue::TAKEN)
+	    {
+		break;
+	    }
+	}
+	if(!pushed)
+	{
+	    return false;
+	}
+	afterPush();
+	if(m_unbuffered)
+	{
+	    // 等到接收方取走这个位置上的值，通道关闭时不再等待
+	    auto taken = [this,pos](){return m_head.load() > pos || m_closed.load();};
+	    while(!taken())
+	    {
+		if(m_ackq.wait(taken,std::chrono::nanoseconds(-1)) == WaitQueue::TAKEN)
+		{
+		    break;
+		}
+	    }
+	}
+	return true;
+    }
+
+    // 通道为空时挂起，关闭且已经取完时返回false
+    bool recv(T& out)
+    {
+	bool popped = false;
+	auto attempt = [&]()
+	{
+	    popped = tryPop(out);
+	    return popped || m_closed.load();
+	};
+	while(!attempt())
+	{
+	    if(m_recvq.wait(attempt,std::chrono::nanoseconds(-1)) == WaitQueue::TAKEN)
+	    {
+		break;
+	    }
+	}
+	// 关闭之前已经放入的值仍然可以取到
+	if(!popped)
+	{
+	    popped = tryPop(out);
+	}
+	if(popped)
+	{
+	    afterPop();
+	}
+	return popped;
+    }
+
+    // 不挂起，通道已满或已经关闭时返回false．value只在成功时被移走
+    // 无缓冲通道只有在有挂起的接收方时才成功：放入值的同时认领一个接收方并唤醒它
+    bool trySend(T&& value)
+    {
+	size_t pos;
+	if(m_closed.load())
+	{
+	    return false;
+	}
+	if(!m_unbuffered)
+	{
+	    if(!tryPush(value,pos))
+	    {
+		return false;
+	    }
+	    afterPush();
+	    return true;
+	}
+	// wake在持有接收队列的锁时调用try_take，认领队首失败（已经超时）时调用give_back再试下一个，
+	// 认领成功后队列不空时会再调用一次try_take，返回false结束
+	enum {NONE, PUSHED, RETRY};
+	int state = NONE;
+	m_recvq.wake([&]()
+	{
+	    if(state == PUSHED)
+	    {
+		return false;
+	    }
+	    if(state == RETRY || tryPush(value,pos))
+	    {
+		state = PUSHED;
+		return true;
+	    }
+	    return false;
+	},[&](){state = RETRY;});
+	if(state != RETRY)
+	{
+	    return state == PUSHED;
+	}
+	// 队列里只剩超时的接收方，把值取回来（容量为1，环里只有这一个值）；已经被别的接收方取走则算发送成功
+	if(!tryPop(value))
+	{
+	    return true;
+	}
+	notify(m_sendq);
+	return false;
+    }
+
+    bool trySend(const T& value)
+    {
+	T copy(value);
+	return trySend(std::move(copy));
+    }
+
+    // 不挂起，通道为空时返回false
+    bool tryRecv(T& out)
+    {
+	if(!tryPop(out))
+	{
+	    return false;
+	}
+	afterPop();
+	return true;
+    }
+
+    // 关闭通道并唤醒所有等待者
+    void close()
+    {
+	if(m_closed.exchange(true))
+	{
+	    return;
+	}
+	m_recvq.wakeAll();
+	m_sendq.wakeAll();
+	m_ackq.wakeAll();
+    }
+
+    bool isClosed() const {return m_closed.load();}
+    size_t getCapacity() const {return m_unbuffered ? 0 : m_capacity;}
+    // 缓冲区中的值的个数（近似值）
+    size_t size() const
+    {
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	size_t head = m_head.load(std::memory_order_relaxed);
+	return tail > head ? tail - head : 0;
+    }
+};
+
+// 同时等待多个通道操作，按添加的顺序检查，返回第一个完成的分支的下标
+//     int v; bool ok;
+//     Select sel;
+//     sel.recv(ch1, &v, &ok).send(ch2, 42);
+//     switch(sel.wait()) {...}
+// 挂起时同一个等待者登记在所有分支的通道上，先到的通知生效
+class Select
+{
+private:
+    struct Case
+    {
+	WaitQueue* queue;
+	// 操作完成（或通道已经关闭）返回true
+	std::function<bool()> attempt;
+    };
+    std::vector<Case> m_cases;
+
+public:
+    // 接收到值时*ok为true，通道已经关闭且取完时分支也会被选中，*ok为false
+    template <class T>
+    Select& recv(Channel<T>& channel, T* out, bool* ok = nullptr)
+    {
+	m_cases.push_back({&channel.m_recvq,[&channel,out,ok]()
+	{
+	    bool got = channel.tryRecv(*out);
+	    if(!got && !channel.isClosed())
+	    {
+		return false;
+	    }
+	    if(ok)
+	    {
+		*ok = got;
+	    }
+	    return true;
+	}});
+	return *this;
+    }
+
+    // 值放入通道时*ok为true，通道已经关闭时分支也会被选中，*ok为false
+    // 挂起的Select只登记在发送队列上，来了接收方也不会被唤醒，所以不支持无缓冲通道，抛出std::logic_error
+    template <class T>
+    Select& send(Channel<T>& channel, T value, bool* ok = nullptr)
+    {
+	if(channel.m_unbuffered)
+	{
+	    throw std::logic_error("Select::send requires a buffered channel");
+	}
+	std::shared_ptr<T> holder = std::make_shared<T>(std::move(value));
+	m_cases.push_back({&channel.m_sendq,[&channel,holder,ok]()
+	{
+	    bool sent = channel.trySend(std::move(*holder));
+	    if(!sent && !channel.isClosed())
+	    {
+		return false;
+	    }
+	    if(ok)
+	    {
+		*ok = sent;
+	    }
+	    return true;
+	}});
+	return *this;
+    }
+
+    // 不挂起，没有可以完成的分支时返回-1
+    int tryOnce();
+    // 挂起直到某个分支完成；timeout大于等于0时超时返回-1
+    int wait(std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1));
+};
+}
+#endif
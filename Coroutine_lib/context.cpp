@@ -0,0 +1,80 @@
+/*
+ - File Name: context.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sat 17 Oct 2026 10:31:05 AM CST
+ */
+
+#include "context.h"
+#include <cstring>
+
+namespace Hourglass
+{
+#ifdef HOURGLASS_CONTEXT_USE_UCONTEXT
+int initContext(Context* ctx)
+{
+    return getcontext(&ctx->uc);
+}
+
+int makeContext(Context* ctx, void* stack, size_t size, void (*func)())
+{
+    if(getcontext(&ctx->uc))
+    {
+	return -1;
+    }
+    ctx->uc.uc_link = nullptr;
+    ctx->uc.uc_stack.ss_sp = stack;
+    ctx->uc.uc_stack.ss_size = size;
+    makecontext(&ctx->uc, func, 0);
+    return 0;
+}
+
+const char* contextBackend()
+{
+    return "ucontext";
+}
+#else
+int initContext(Context* ctx)
+{
+    // 汇编后端在第一次切出时才写入 sp
+    ctx->sp = nullptr;
+    return 0;
+}
+
+// 初始栈帧的布局必须与 context_*.S 中的出栈顺序一致
+int makeContext(Context* ctx, void* stack, size_t size, void (*func)())
+{
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+#if defined(__x86_64__)
+    // 低地址 -> 高地址: mxcsr/x87cw, r15, r14, r13, r12, rbx, rbp, ret
+    // 切入后 rbx 为入口函数，ret 跳到跳板，此时 rsp == top 保持16字节对齐
+    uint64_t* frame = (uint64_t*)(top - 8 * 8);
+    memset(frame, 0, 8 * 8);
+    uint32_t mxcsr = 0x1F80;
+    uint16_t fpucw = 0x037F;
+    memcpy((char*)frame, &mxcsr, sizeof(mxcsr));
+    memcpy((char*)frame + 4, &fpucw, sizeof(fpucw));
+    frame[5] = (uint64_t)func;
+    frame[7] = (uint64_t)&hourglass_context_entry;
+#elif defined(__aarch64__)
+    // 低地址 -> 高地址: d8-d15, x19-x28, x29, x30
+    // 切入后 x19 为入口函数，x30(lr) 指向跳板
+    uint64_t* frame = (uint64_t*)(top - 20 * 8);
+    memset(frame, 0, 20 * 8);
+    frame[8] = (uint64_t)func;
+    frame[19] = (uint64_t)&hourglass_context_entry;
+#endif
+    ctx->sp = frame;
+    return 0;
+}
+
+const char* contextBackend()
+{
+#if defined(__x86_64__)
+    return "asm-x86_64";
+#else
+    return "asm-aarch64";
+#endif
+}
+#endif
+}
@@ -0,0 +1,61 @@
+/*
+ - File Name: context.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sat 17 Oct 2026 10:12:40 AM CST
+ */
+
+#ifndef _CONTEXT_H_
+#define _CONTEXT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// 上下文切换后端：x86-64/aarch64 默认使用手写汇编，只保存被调用者保存寄存器．
+// 其他架构或定义了 HOURGLASS_CONTEXT_UCONTEXT 时退回 ucontext．
+#if defined(HOURGLASS_CONTEXT_UCONTEXT) || !(defined(__x86_64__) || defined(__aarch64__))
+#define HOURGLASS_CONTEXT_USE_UCONTEXT 1
+#include <ucontext.h>
+#endif
+
+namespace Hourglass
+{
+#ifndef HOURGLASS_CONTEXT_USE_UCONTEXT
+extern "C"
+{
+// 保存当前寄存器到当前栈上，把栈顶写入 *from_sp，然后切到 to_sp
+void hourglass_context_swap(void** from_sp, void* to_sp);
+// 新上下文第一次被切入时的跳板，负责调用入口函数
+void hourglass_context_entry();
+}
+#endif
+
+struct Context
+{
+#ifdef HOURGLASS_CONTEXT_USE_UCONTEXT
+    ucontext_t uc;
+#else
+    // 挂起时的栈顶，寄存器都保存在栈上
+    void* sp = nullptr;
+#endif
+};
+
+// 以下函数与 getcontext/makecontext/swapcontext 一一对应，成功返回0
+// 初始化一个用于保存现场的上下文（主协程）
+int initContext(Context* ctx);
+// 在 [stack, stack + size) 上构造一个从 func 开始执行的上下文，func 不能返回
+int makeContext(Context* ctx, void* stack, size_t size, void (*func)());
+// 当前后端的名字，便于日志与基准测试
+const char* contextBackend();
+
+inline int swapContext(Context* from, Context* to)
+{
+#ifdef HOURGLASS_CONTEXT_USE_UCONTEXT
+    return swapcontext(&from->uc, &to->uc);
+#else
+    hourglass_context_swap(&from->sp, to->sp);
+    return 0;
+#endif
+}
+}
+#endif
@@ -6,15 +6,33 @@
  */
 
 #include "coroutine.h"
+#include "stack.h"
+#include "thread.h"
+#include "trace.h"
+#include <cstring>
 
 namespace Hourglass
 {
+// 每个线程一个共享执行栈，第一次有共享栈协程运行时才分配
+struct SharedStack
+{
+    void* stack = nullptr;
+    size_t size = 0;
+    // 当前栈上保留着哪个协程的内容，为它恢复时可以省去拷贝
+    uint64_t owner = (uint64_t)-1;
+    ~SharedStack()
+    {
+	StackAllocator::deallocate(stack,size);
+    }
+};
 
 static thread_local Coroutine* t_coroutine = nullptr;
 static thread_local std::shared_ptr<Coroutine> t_thread_coroutine = nullptr;
 static thread_local Coroutine* t_scheduler_cor = nullptr;
 static std::atomic<uint64_t> t_coroutine_id{0};
 static std::atomic<uint64_t> t_coroutine_count{0};
+static thread_local SharedStack t_shared_stack;
+static std::atomic<size_t> s_shared_stack_size{1024 * 1024};
 
 uint64_t Coroutine::getCorID()
 {
@@ -35,11 +53,16 @@ void Coroutine::setSchedulerCortinue(Coroutine* cor)
     t_scheduler_cor = cor;
 }
 
+void Coroutine::setSharedStackSize(size_t size)
+{
+    s_shared_stack_size = StackAllocator::roundSize(size);
+}
+
 Coroutine::Coroutine()
 {
     setCoroutine(this);
     coroutineState = RUNNING;
-    if(getcontext(&coroutineCT))
+    if(initContext(&coroutineCT))
     {
 	std::cerr << "Coroutine() Failed!\n";
 	pthread_exit(NULL);
@@ -48,21 +71,34 @@ Coroutine::Coroutine()
     t_coroutine_count++;
 }
 
-Coroutine::Coroutine(std::function<void()> func, size_t stack_size,bool runinscheduler):coroutineFunc(func),runInSchedulerCor(runinscheduler)
+Coroutine::Coroutine(InlineFunction func, size_t stack_size,bool runinscheduler):coroutineFunc(std::move(func)),runInSchedulerCor(runinscheduler)
 {
-    setCoroutine(this);
     coroutineState = READY;
-    coroutineStackSize = stack_size ? stack_size : 128000;
-    coroutineStack = malloc(coroutineStackSize);
-    if(getcontext(&coroutineCT))
+#ifndef HOURGLASS_CONTEXT_USE_UCONTEXT
+    if(stack_size == SHARED_STACK)
+    {
+	// 上下文在第一次resume时才在共享栈上构造
+	sharedMode = true;
+	sharedNeedMake = true;
+	coroutineID = t_coroutine_id++;
+	t_coroutine_count++;
+	return;
+    }
+#else
+    if(stack_size == SHARED_STACK)
+    {
+	stack_size = 0;
+    }
+#endif
+    coroutineStackSize = StackAllocator::roundSize(stack_size ? stack_size : DEFAULT_STACK_SIZE);
+    coroutineStack = StackAllocator::allocate(coroutineStackSize);
+    stackDirty = coroutineStackSize;
+    paintStack();
+    if(makeContext(&coroutineCT,coroutineStack,coroutineStackSize,&Coroutine::mainFunc))
     {
 	std::cerr << "Coroutine(func,stack_size) Failed!\n";
 	pthread_exit(NULL);
     }
-    coroutineCT.uc_link = nullptr;
-    coroutineCT.uc_stack.ss_sp = coroutineStack;
-    coroutineCT.uc_stack.ss_size = coroutineStackSize;
-    makecontext(&coroutineCT,&Coroutine::mainFunc,0);
     coroutineID = t_coroutine_id++;
     t_coroutine_count++;
 }
@@ -72,18 +108,65 @@ Coroutine::~Coroutine()
     t_coroutine_count--;
     if(coroutineStack)
     {
-	free(coroutineStack);
+	StackAllocator::deallocate(coroutineStack,coroutineStackSize);
+    }
+}
+
+void Coroutine::restoreSharedStack()
+{
+    if(!sharedStack)
+    {
+	if(!t_shared_stack.stack)
+	{
+	    t_shared_stack.size = s_shared_stack_size;
+	    t_shared_stack.stack = StackAllocator::allocate(t_shared_stack.size);
+	}
+	sharedStack = &t_shared_stack;
+	sharedThread = Thread::GetThreadID();
+    }
+    // 栈上的指针都是绝对地址，只能回到同一个共享栈上运行
+    assert(sharedStack == &t_shared_stack);
+    if(sharedNeedMake)
+    {
+	if(makeContext(&coroutineCT,sharedStack->stack,sharedStack->size,&Coroutine::mainFunc))
+	{
+	    std::cerr << "restoreSharedStack() failed!\n";
+	    pthread_exit(NULL);
+	}
+	sharedNeedMake = false;
+    }
+    else if(sharedStack->owner != coroutineID)
+    {
+	char* top = (char*)sharedStack->stack + sharedStack->size;
+	memcpy(top - sharedSaved.size(),sharedSaved.data(),sharedSaved.size());
     }
+    sharedStack->owner = coroutineID;
+}
+
+void Coroutine::saveSharedStack()
+{
+#ifndef HOURGLASS_CONTEXT_USE_UCONTEXT
+    char* top = (char*)sharedStack->stack + sharedStack->size;
+    sharedSaved.assign((char*)coroutineCT.sp,top);
+#endif
 }
 
 void Coroutine::resume()
 {
     assert(coroutineState == READY);
     coroutineState = RUNNING;
+    if(sharedMode)
+    {
+	restoreSharedStack();
+    }
+    if(Tracer::isEnabled())
+    {
+	Tracer::record(Tracer::RESUME,coroutineID);
+    }
     if(runInSchedulerCor)
     {
 	setCoroutine(this);
-	if(swapcontext(&(t_scheduler_cor->coroutineCT),&coroutineCT))
+	if(swapContext(&(t_scheduler_cor->coroutineCT),&coroutineCT))
 	{
 	    std::cerr << "resume() to t_scheduler_coroutine failed!\n";
 	    pthread_exit(NULL);
@@ -92,12 +175,21 @@ void Coroutine::resume()
     else 
     {
 	setCoroutine(this);
-	if(swapcontext(&(t_thread_coroutine->coroutineCT),&coroutineCT))
+	if(swapContext(&(t_thread_coroutine->coroutineCT),&coroutineCT))
 	{
 	    std::cerr << "resume() failed!\n";
 	    pthread_exit(NULL);
 	}
     }
+    // 已经切回调用方，共享栈可以交给别的协程使用
+    if(sharedMode && coroutineState != TERM)
+    {
+	saveSharedStack();
+    }
+    if(stackPainted && coroutineState == TERM)
+    {
+	measureStack();
+    }
 }
 
 void Coroutine::yield()
@@ -107,10 +199,14 @@ void Coroutine::yield()
     {
 	coroutineState = READY;
     }
+    if(Tracer::isEnabled())
+    {
+	Tracer::record(Tracer::YIELD,coroutineID,coroutineState == TERM);
+    }
     if(runInSchedulerCor)
     {
-	setCoroutine(this);
-	if(swapcontext(&coroutineCT,&(t_scheduler_cor->coroutineCT)))
+	setCoroutine(t_scheduler_cor);
+	if(swapContext(&coroutineCT,&(t_scheduler_cor->coroutineCT)))
 	{
 	    std::cerr << "yield() t_scheduler_cor failed!\n";
 	    pthread_exit(NULL);
@@ -118,8 +214,8 @@ void Coroutine::yield()
     }
     else
     {
-	setCoroutine(this);
-	if(swapcontext(&coroutineCT,&(t_thread_coroutine->coroutineCT)))
+	setCoroutine(t_thread_coroutine.get());
+	if(swapContext(&coroutineCT,&(t_thread_coroutine->coroutineCT)))
 	{
 	    std::cerr << "yield() falied!\n";
 	    pthread_exit(NULL);
@@ -127,20 +223,55 @@ void Coroutine::yield()
     }
 }
 
-void Coroutine::reset(std::function<void()> func)
+void Coroutine::reset(InlineFunction func)
 {
-    assert(coroutineStack != nullptr && coroutineState == TERM);
+    assert((coroutineStack != nullptr || sharedMode) && coroutineState == TERM);
     coroutineState = READY;
-    coroutineFunc = func;
-    if(getcontext(&coroutineCT))
+    coroutineFunc = std::move(func);
+    stackTag = nullptr;
+    stackSite = nullptr;
+    if(sharedMode)
+    {
+	sharedNeedMake = true;
+	sharedSaved.clear();
+	return;
+    }
+    paintStack();
+    if(makeContext(&coroutineCT,coroutineStack,coroutineStackSize,&Coroutine::mainFunc))
     {
 	std::cerr << "reset() failed!\n";
 	pthread_exit(NULL);
     }
-    coroutineCT.uc_link = nullptr;
-    coroutineCT.uc_stack.ss_sp = coroutineStack;
-    coroutineCT.uc_stack.ss_size = coroutineStackSize;
-    makecontext(&coroutineCT, &Coroutine::mainFunc, 0);
+}
+
+void Coroutine::releaseStack()
+{
+    assert(coroutineState == TERM);
+    // 栈顶一页很快会被reset后的入口函数再次用到，保留
+    StackAllocator::release(coroutineStack,coroutineStackSize,StackAllocator::pageSize());
+    // 归还的页再次访问时可能是全零，需要重新填充
+    stackDirty = coroutineStackSize;
+}
+
+void Coroutine::paintStack()
+{
+    stackPainted = StackProfiler::isEnabled();
+    if(stackPainted)
+    {
+	StackProfiler::paint(coroutineStack,coroutineStackSize,stackDirty);
+	stackDirty = 0;
+    }
+    else
+    {
+	stackDirty = coroutineStackSize;
+    }
+}
+
+void Coroutine::measureStack()
+{
+    stackDirty = StackProfiler::measure(coroutineStack,coroutineStackSize);
+    stackPainted = false;
+    StackProfiler::record(stackTag,stackSite,stackDirty,coroutineStackSize);
 }
 
 std::shared_ptr<Coroutine> Coroutine::getCoroutine()
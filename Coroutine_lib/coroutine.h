@@ -13,10 +13,14 @@
 #include <mutex>
 #include <atomic>
 #include <unistd.h>
-#include <ucontext.h>
 #include <iostream>
+#include <vector>
+#include <typeinfo>
+#include "context.h"
+#include "inline_function.h"
 
 namespace Hourglass{
+struct SharedStack;
     // enable_shared_from 允许一个类（通常是shared_ptr管理的类）安全的生成指向自身（this）的std::shared_ptr的实例．
     // 意味着当使用shared_ptr来管理对象的生命周期时，想要在对象的成员函数中获取对象的shared_ptr的实例，直接用this来代替． 
     // 造一个share_ptr会出错．多个shared_ptr管理同一个对象可能会造成重析构的问题．
@@ -32,17 +36,44 @@ protected:
     // 协程状态　简化
     State coroutineState = READY;
     // 上下文结构
-    ucontext_t coroutineCT;
+    Context coroutineCT;
     // 栈地址
     void* coroutineStack = nullptr;
     // 栈大小
     uint32_t coroutineStackSize = 0;
     // 协程入口函数
-    std::function<void()> coroutineFunc;
+    InlineFunction coroutineFunc;
     // 无参构造
     Coroutine();
     //是否会参加调度协程的调度
     bool runInSchedulerCor;
+    // 共享栈模式: 在线程的共享执行栈上运行，挂起时只把用到的部分拷贝到 sharedSaved
+    bool sharedMode = false;
+    // 是否需要在共享栈上重新构造上下文（刚创建或reset之后）
+    bool sharedNeedMake = false;
+    // 绑定的共享栈及其所属线程，第一次resume时确定
+    SharedStack* sharedStack = nullptr;
+    int sharedThread = -1;
+    // 挂起时保存的栈内容
+    std::vector<char> sharedSaved;
+    // 调度优先级（Scheduler::Priority，默认NORMAL）和截止时间（steady_clock的纳秒数，0表示没有），
+    // 由调度器在运行任务时设置，协程挂起后被重新调度时沿用
+    int schedPriority = 1;
+    int64_t schedDeadline = 0;
+    // 栈用量测量（StackProfiler）：标签、提交任务的函数对象类型，
+    // 栈顶往下可能不再是填充图案的字节数，以及这次运行前栈是否填充过
+    const char* stackTag = nullptr;
+    const std::type_info* stackSite = nullptr;
+    size_t stackDirty = 0;
+    bool stackPainted = false;
+    // 开启测量时在构造上下文之前填充栈
+    void paintStack();
+    // 结束后测量并记录用量
+    void measureStack();
+    // 挂起后把共享栈上的内容拷出
+    void saveSharedStack();
+    // 恢复前把保存的内容拷回共享栈
+    void restoreSharedStack();
  
 public:
     /* 获取属性相关的成员 attributes */
@@ -50,13 +81,40 @@ public:
     uint64_t getID() const {return coroutineID;}
     // 获取协程状态
     State getState() const {return coroutineState;}
+    // 获取栈大小，主协程为0
+    uint32_t getStackSize() const {return coroutineStackSize;}
+    // 是否与调度协程进行切换
+    bool isRunInScheduler() const {return runInSchedulerCor;}
     // 获取当前运行的协程ID
     static uint64_t getCorID();
 
     /* 协程行为相关的成员　behavior */
     // 无参构造　由于不想直接通过类进行创建实例，通过方法直接进行构造，转化为私有化．
-    // 有参构造
-    Coroutine(std::function<void()> func, size_t stack_size=0,bool runinscheduler=true);
+    // 有参构造 stack_size 会向上取整到 StackAllocator 的分级，0 表示默认大小
+    Coroutine(InlineFunction func, size_t stack_size=0,bool runinscheduler=true);
+    // 默认栈大小
+    static const size_t DEFAULT_STACK_SIZE = 128000;
+    // 作为 stack_size 传入时使用共享栈模式．
+    // 共享栈协程第一次运行后绑定在该线程上，之后只能在这个线程上恢复，
+    // 并且不能在共享栈协程内部resume另一个共享栈协程．ucontext 后端下退化为默认大小的独立栈．
+    static const size_t SHARED_STACK = (size_t)-1;
+    // 设置每个线程共享执行栈的大小，在线程第一次使用共享栈之前生效
+    static void setSharedStackSize(size_t size);
+    // 是否为共享栈协程
+    bool isSharedStack() const {return sharedMode;}
+    // 共享栈协程绑定的线程id，未绑定或非共享栈协程返回-1
+    int getBoundThread() const {return sharedThread;}
+    // 共享栈协程挂起时保存的字节数
+    size_t getSavedStackSize() const {return sharedSaved.size();}
+    // 调度优先级与截止时间
+    int getPriority() const {return schedPriority;}
+    int64_t getDeadline() const {return schedDeadline;}
+    void setPriority(int priority, int64_t deadline = 0) {schedPriority = priority;schedDeadline = deadline;}
+    // 栈用量按标签汇总，tag需要一直有效（如字符串字面量）；reset时清空
+    void setStackTag(const char* tag) {stackTag = tag;}
+    const char* getStackTag() const {return stackTag;}
+    // 没有标签时按提交位置汇总，由调度器设置为任务函数对象的类型
+    void setStackSite(const std::type_info* site) {stackSite = site;}
     // 析构
     ~Coroutine();
     // 利用类对getCoroutine方法进行调用无参构造，提供一个用户接口
@@ -70,7 +128,9 @@ public:
     // 让出执行
     void yield();
     // 重用一个协程
-    void reset(std::function<void()> func);
+    void reset(InlineFunction func);
+    // 已结束的协程把栈的物理页归还给内核，保留映射以便reset后继续使用
+    void releaseStack();
     // 想将协程操作再封装成一个成员，当协程进行操作时，直接绑定函数就可以了
     static void mainFunc();
     // 设置调度协程，默认主协程
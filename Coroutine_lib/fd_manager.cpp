@@ -0,0 +1,117 @@
+/*
+ - File Name: fd_manager.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Thu 22 Oct 2026 02:47:10 PM CST
+ */
+
+#include "fd_manager.h"
+#include "hook.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <mutex>
+
+namespace Hourglass
+{
+FdCtx::FdCtx(size_t fd):m_fd((int)fd)
+{
+}
+
+bool FdCtx::init()
+{
+    if(isInit())
+    {
+	return true;
+    }
+    std::lock_guard<SpinLock> lock(m_mutex);
+    if(isInit())
+    {
+	return true;
+    }
+    struct stat statbuf;
+    if(fstat(m_fd,&statbuf) == -1)
+    {
+	return false;
+    }
+    bool is_socket = S_ISSOCK(statbuf.st_mode);
+    // socket统一设置成非阻塞，由hook在EAGAIN时挂起协程
+    if(is_socket)
+    {
+	int flags = fcntl_f(m_fd,F_GETFL,0);
+	if(!(flags & O_NONBLOCK))
+	{
+	    fcntl_f(m_fd,F_SETFL,flags | O_NONBLOCK);
+	}
+    }
+    m_isSocket.store(is_socket,std::memory_order_relaxed);
+    m_sysNonblock.store(is_socket,std::memory_order_relaxed);
+    m_userNonblock.store(false,std::memory_order_relaxed);
+    m_recvTimeout.store((uint64_t)-1,std::memory_order_relaxed);
+    m_sendTimeout.store((uint64_t)-1,std::memory_order_relaxed);
+    m_isClosed.store(false,std::memory_order_relaxed);
+    m_isInit.store(true,std::memory_order_release);
+    return true;
+}
+
+void FdCtx::reset()
+{
+    std::lock_guard<SpinLock> lock(m_mutex);
+    if(!isInit())
+    {
+	return;
+    }
+    m_isClosed.store(true,std::memory_order_release);
+    m_isInit.store(false,std::memory_order_release);
+}
+
+void FdCtx::setTimeout(int type, uint64_t v)
+{
+    if(type == SO_RCVTIMEO)
+    {
+	m_recvTimeout.store(v,std::memory_order_relaxed);
+    }
+    else
+    {
+	m_sendTimeout.store(v,std::memory_order_relaxed);
+    }
+}
+
+uint64_t FdCtx::getTimeout(int type) const
+{
+    return (type == SO_RCVTIMEO ? m_recvTimeout : m_sendTimeout).load(std::memory_order_relaxed);
+}
+
+FdCtx* FdManager::get(int fd, bool auto_create)
+{
+    if(fd < 0)
+    {
+	return nullptr;
+    }
+    FdCtx* ctx = m_datas.get(fd,auto_create);
+    if(!ctx)
+    {
+	return nullptr;
+    }
+    if(ctx->isInit())
+    {
+	return ctx;
+    }
+    return auto_create && ctx->init() ? ctx : nullptr;
+}
+
+void FdManager::del(int fd)
+{
+    FdCtx* ctx = fd < 0 ? nullptr : m_datas.get(fd,false);
+    if(ctx)
+    {
+	ctx->reset();
+    }
+}
+
+FdManager* FdManager::GetInstance()
+{
+    static FdManager s_instance;
+    return &s_instance;
+}
+}
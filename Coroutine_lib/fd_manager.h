@@ -0,0 +1,74 @@
+/*
+ - File Name: fd_manager.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Thu 22 Oct 2026 02:18:45 PM CST
+ */
+
+#ifndef _FD_MANAGER_H_
+#define _FD_MANAGER_H_
+
+#include "fdtable.h"
+#include "spinlock.h"
+#include <atomic>
+#include <cstdint>
+
+namespace Hourglass
+{
+// hook需要知道的fd状态：是否是socket、用户是否自己设置了非阻塞、收发超时．
+// 存放在FdManager的分页表中，fd关闭时只重置不释放，关闭之前取到指针的一方看到isClosed
+class FdCtx
+{
+private:
+    // init与reset互斥，读取各字段不加锁
+    SpinLock m_mutex;
+    std::atomic<bool> m_isInit = {false};
+    std::atomic<bool> m_isSocket = {false};
+    // hook为socket设置的O_NONBLOCK
+    std::atomic<bool> m_sysNonblock = {false};
+    // 用户通过fcntl/ioctl设置的非阻塞，为true时hook不再代为等待
+    std::atomic<bool> m_userNonblock = {false};
+    std::atomic<bool> m_isClosed = {false};
+    int m_fd;
+    // SO_RCVTIMEO/SO_SNDTIMEO，单位毫秒，-1表示不超时
+    std::atomic<uint64_t> m_recvTimeout = {(uint64_t)-1};
+    std::atomic<uint64_t> m_sendTimeout = {(uint64_t)-1};
+
+public:
+    explicit FdCtx(size_t fd);
+
+    // fd打开后第一次用到时调用，已经初始化过直接返回
+    bool init();
+    // fd关闭时调用，之后isClosed为true直到再次init
+    void reset();
+    bool isInit() const {return m_isInit.load(std::memory_order_acquire);}
+    bool isSocket() const {return m_isSocket.load(std::memory_order_relaxed);}
+    bool isClosed() const {return m_isClosed.load(std::memory_order_acquire);}
+
+    void setUserNonblock(bool v) {m_userNonblock.store(v,std::memory_order_relaxed);}
+    bool getUserNonblock() const {return m_userNonblock.load(std::memory_order_relaxed);}
+
+    void setSysNonblock(bool v) {m_sysNonblock.store(v,std::memory_order_relaxed);}
+    bool getSysNonblock() const {return m_sysNonblock.load(std::memory_order_relaxed);}
+
+    // type为SO_RCVTIMEO或SO_SNDTIMEO
+    void setTimeout(int type, uint64_t v);
+    uint64_t getTimeout(int type) const;
+};
+
+// 每次hook的read/write/connect都要查表，与IOManager的fd上下文一样用不加锁的分页表
+class FdManager
+{
+public:
+    // 取fd的上下文，没有初始化过且auto_create为true时初始化，否则返回nullptr．
+    // 返回的指针一直有效，fd关闭后isClosed为true
+    FdCtx* get(int fd, bool auto_create = false);
+    void del(int fd);
+
+    static FdManager* GetInstance();
+
+private:
+    PagedTable<FdCtx> m_datas;
+};
+}
+#endif
@@ -0,0 +1,103 @@
+/*
+ - File Name: fdtable.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Fri 23 Oct 2026 10:42:08 AM CST
+ */
+
+#ifndef _FDTABLE_H_
+#define _FDTABLE_H_
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstddef>
+
+namespace Hourglass
+{
+// 按fd索引的两级分页表：第一级是固定大小的页指针数组，第二级的页在第一次用到时才分配．
+// 读取不加锁（两次acquire读），分配新页时用CAS发布，竞争失败的一方释放自己的页．
+// 页一旦分配就不会移动或释放，返回的指针在表的生命周期内一直有效．
+// T需要有以下标为参数的构造函数．
+template <class T, int PAGE_BITS = 10, int TOP_BITS = 14>
+class PagedTable
+{
+public:
+    static const size_t PAGE_SIZE = (size_t)1 << PAGE_BITS;
+    static const size_t CAPACITY = (size_t)1 << (PAGE_BITS + TOP_BITS);
+
+private:
+    struct Page
+    {
+	alignas(T) unsigned char storage[sizeof(T) * PAGE_SIZE];
+
+	explicit Page(size_t base)
+	{
+	    for(size_t i = 0;i < PAGE_SIZE;i++)
+	    {
+		new (&storage[sizeof(T) * i]) T(base + i);
+	    }
+	}
+	~Page()
+	{
+	    for(size_t i = 0;i < PAGE_SIZE;i++)
+	    {
+		at(i)->~T();
+	    }
+	}
+	T* at(size_t i) {return reinterpret_cast<T*>(&storage[sizeof(T) * i]);}
+    };
+
+    std::unique_ptr<std::atomic<Page*>[]> m_pages;
+    std::atomic<size_t> m_pageCount = {0};
+
+public:
+    PagedTable():m_pages(new std::atomic<Page*>[(size_t)1 << TOP_BITS]())
+    {
+    }
+
+    ~PagedTable()
+    {
+	for(size_t i = 0;i < ((size_t)1 << TOP_BITS);i++)
+	{
+	    delete m_pages[i].load(std::memory_order_relaxed);
+	}
+    }
+
+    PagedTable(const PagedTable&) = delete;
+    PagedTable& operator=(const PagedTable&) = delete;
+
+    // 取下标为index的元素．所在的页不存在时，create为true则分配，否则返回nullptr；超出容量返回nullptr
+    T* get(size_t index, bool create)
+    {
+	if(index >= CAPACITY)
+	{
+	    return nullptr;
+	}
+	std::atomic<Page*>& slot = m_pages[index >> PAGE_BITS];
+	Page* page = slot.load(std::memory_order_acquire);
+	if(!page)
+	{
+	    if(!create)
+	    {
+		return nullptr;
+	    }
+	    Page* fresh = new Page(index & ~(PAGE_SIZE - 1));
+	    if(slot.compare_exchange_strong(page,fresh,std::memory_order_acq_rel,std::memory_order_acquire))
+	    {
+		page = fresh;
+		m_pageCount.fetch_add(1,std::memory_order_relaxed);
+	    }
+	    else
+	    {
+		delete fresh;
+	    }
+	}
+	return page->at(index & (PAGE_SIZE - 1));
+    }
+
+    // 已经分配的页数
+    size_t getPageCount() const {return m_pageCount.load(std::memory_order_relaxed);}
+};
+}
+#endif
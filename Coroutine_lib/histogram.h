@@ -0,0 +1,119 @@
+/*
+ - File Name: histogram.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Thu 29 Oct 2026 03:12:40 PM CST
+ */
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace Hourglass
+{
+// 以2的幂为桶边界的时延直方图，记录只有一次relaxed的原子加，可以在多个线程上同时记录．
+// 第0个桶统计0ns，第i个桶统计[2^(i-1), 2^i)ns，最后一个桶统计更大的值
+class LatencyHistogram
+{
+public:
+    static const size_t BUCKETS = 48;
+
+private:
+    std::atomic<uint64_t> m_buckets[BUCKETS];
+    std::atomic<uint64_t> m_sum = {0};
+
+public:
+    LatencyHistogram()
+    {
+	reset();
+    }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    static size_t bucketOf(uint64_t ns)
+    {
+	size_t index = ns ? 64 - __builtin_clzll(ns) : 0;
+	return index < BUCKETS ? index : BUCKETS - 1;
+    }
+
+    // 第index个桶的上界（不含）
+    static uint64_t bucketBound(size_t index)
+    {
+	return index == 0 ? 1 : (uint64_t)1 << index;
+    }
+
+    void record(uint64_t ns)
+    {
+	m_buckets[bucketOf(ns)].fetch_add(1,std::memory_order_relaxed);
+	m_sum.fetch_add(ns,std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+	for(size_t i = 0;i < BUCKETS;i++)
+	{
+	    m_buckets[i].store(0,std::memory_order_relaxed);
+	}
+	m_sum.store(0,std::memory_order_relaxed);
+    }
+
+    // 各个桶的计数的快照
+    std::vector<uint64_t> getBuckets() const
+    {
+	std::vector<uint64_t> buckets(BUCKETS);
+	for(size_t i = 0;i < BUCKETS;i++)
+	{
+	    buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+	}
+	return buckets;
+    }
+
+    uint64_t getCount() const
+    {
+	uint64_t count = 0;
+	for(size_t i = 0;i < BUCKETS;i++)
+	{
+	    count += m_buckets[i].load(std::memory_order_relaxed);
+	}
+	return count;
+    }
+
+    uint64_t getSum() const {return m_sum.load(std::memory_order_relaxed);}
+
+    // 百分位数（0~100），返回所在桶的上界，没有样本时返回0
+    uint64_t percentile(double p) const
+    {
+	std::vector<uint64_t> buckets = getBuckets();
+	uint64_t count = 0;
+	for(uint64_t n : buckets)
+	{
+	    count += n;
+	}
+	if(count == 0)
+	{
+	    return 0;
+	}
+	uint64_t rank = (uint64_t)(count * p / 100.0);
+	if(rank >= count)
+	{
+	    rank = count - 1;
+	}
+	uint64_t seen = 0;
+	for(size_t i = 0;i < BUCKETS;i++)
+	{
+	    seen += buckets[i];
+	    if(seen > rank)
+	    {
+		return bucketBound(i);
+	    }
+	}
+	return bucketBound(BUCKETS - 1);
+    }
+};
+}
+#endif
@@ -0,0 +1,453 @@
+/*
+ - File Name: hook.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Thu 22 Oct 2026 11:03:17 AM CST
+ */
+
+#include "hook.h"
+#include "ioscheduler.h"
+#include "fd_manager.h"
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <cstdarg>
+#include <cerrno>
+#include <sys/ioctl.h>
+#include <poll.h>
+
+#define HOOK_FUN(XX) \
+    XX(sleep) \
+    XX(usleep) \
+    XX(nanosleep) \
+    XX(socket) \
+    XX(connect) \
+    XX(accept) \
+    XX(read) \
+    XX(recv) \
+    XX(write) \
+    XX(send) \
+    XX(close) \
+    XX(fcntl) \
+    XX(ioctl) \
+    XX(setsockopt)
+
+namespace Hourglass
+{
+static thread_local bool t_hook_enable = false;
+
+bool is_hook_enable()
+{
+    if(t_hook_enable)
+    {
+	return true;
+    }
+    IOManager* iom = IOManager::GetIOManager();
+    return iom && iom->inWorker() && iom->isHookEnable();
+}
+
+void set_hook_enable(bool flag)
+{
+    t_hook_enable = flag;
+}
+
+static void hook_init()
+{
+    static bool is_inited = false;
+    if(is_inited)
+    {
+	return;
+    }
+    is_inited = true;
+#define XX(name) name ## _f = (name ## _fun)dlsym(RTLD_NEXT, #name);
+    HOOK_FUN(XX)
+#undef XX
+}
+
+// 在其他静态对象之前取得原始函数，避免它们的构造函数里调用到还没初始化的hook
+struct HookIniter
+{
+    HookIniter()
+    {
+	hook_init();
+    }
+};
+static HookIniter s_hook_initer __attribute__((init_priority(101)));
+
+// 只有在IOManager的工作线程上才能挂起协程
+static IOManager* hook_iomanager()
+{
+    IOManager* iom = IOManager::GetIOManager();
+    if(!iom || !iom->inWorker())
+    {
+	return nullptr;
+    }
+    return t_hook_enable || iom->isHookEnable() ? iom : nullptr;
+}
+
+// hook接管的socket：被设置成了非阻塞，而用户看到的是阻塞
+static bool hook_managed(FdCtx* ctx)
+{
+    return ctx && ctx->isSocket() && ctx->getSysNonblock() && !ctx->getUserNonblock();
+}
+
+// 在fd上等待event，timeout为-1时不超时．超时返回-1并把errno设置为timeout_errno
+// 超时由IOManager记在fd的事件上下文中，不需要单独的定时器
+static int wait_fd(IOManager* iom, int fd, IOManager::Event event, uint64_t timeout, int timeout_errno)
+{
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if(timeout != (uint64_t)-1)
+    {
+	deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    }
+    int rt = iom->waitEvent(fd,event,deadline);
+    if(rt < 0)
+    {
+	return -1;
+    }
+    if(rt == IOManager::EVENT_TIMEOUT)
+    {
+	errno = timeout_errno;
+	return -1;
+    }
+    return 0;
+}
+
+// 没有开启hook的线程（例如协程迁移到的其他线程）上阻塞线程等待，参数与返回值同wait_fd
+static int poll_fd(int fd, IOManager::Event event, uint64_t timeout, int timeout_errno)
+{
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = event == IOManager::READ ? POLLIN : POLLOUT;
+    auto start = std::chrono::steady_clock::now();
+    while(true)
+    {
+	int wait = -1;
+	if(timeout != (uint64_t)-1)
+	{
+	    int64_t used = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	    wait = used < (int64_t)timeout ? (int)(timeout - used) : 0;
+	}
+	int rt = poll(&pfd,1,wait);
+	if(rt > 0)
+	{
+	    return 0;
+	}
+	if(rt == 0)
+	{
+	    errno = timeout_errno;
+	    return -1;
+	}
+	if(errno != EINTR)
+	{
+	    return -1;
+	}
+    }
+}
+
+static int wait_ready(IOManager* iom, int fd, IOManager::Event event, uint64_t timeout, int timeout_errno)
+{
+    return iom ? wait_fd(iom,fd,event,timeout,timeout_errno) : poll_fd(fd,event,timeout,timeout_errno);
+}
+
+template <typename OriginFun, typename... Args>
+static ssize_t do_io(int fd, OriginFun fun, IOManager::Event event, int timeout_so, Args&&... args)
+{
+    FdCtx* ctx = FdManager::GetInstance()->get(fd);
+    if(!hook_managed(ctx))
+    {
+	return fun(fd,std::forward<Args>(args)...);
+    }
+    // 没有开启hook时也要等待，不能把EAGAIN返回给以为自己在做阻塞调用的代码
+    IOManager* iom = hook_iomanager();
+    uint64_t timeout = ctx->getTimeout(timeout_so);
+    while(true)
+    {
+	ssize_t n = fun(fd,std::forward<Args>(args)...);
+	while(n == -1 && errno == EINTR)
+	{
+	    n = fun(fd,std::forward<Args>(args)...);
+	}
+	if(n != -1 || errno != EAGAIN)
+	{
+	    return n;
+	}
+	// 与内核的SO_RCVTIMEO/SO_SNDTIMEO一致，超时返回EAGAIN
+	if(wait_ready(iom,fd,event,timeout,EAGAIN))
+	{
+	    return -1;
+	}
+    }
+}
+
+// 挂起当前协程一段时间
+static void hook_sleep(IOManager* iom, std::chrono::nanoseconds timeout)
+{
+    std::shared_ptr<Coroutine> cor = Coroutine::getCoroutine();
+    iom->addTimer(timeout,[iom,cor](){iom->schedulerLock(cor);});
+    cor->yield();
+}
+}
+
+using namespace Hourglass;
+
+extern "C"
+{
+#define XX(name) name ## _fun name ## _f = nullptr;
+    HOOK_FUN(XX)
+#undef XX
+
+unsigned int sleep(unsigned int seconds)
+{
+    IOManager* iom = hook_iomanager();
+    if(!iom)
+    {
+	return sleep_f(seconds);
+    }
+    hook_sleep(iom,std::chrono::seconds(seconds));
+    return 0;
+}
+
+int usleep(useconds_t usec)
+{
+    IOManager* iom = hook_iomanager();
+    if(!iom)
+    {
+	return usleep_f(usec);
+    }
+    hook_sleep(iom,std::chrono::microseconds(usec));
+    return 0;
+}
+
+int nanosleep(const struct timespec* req, struct timespec* rem)
+{
+    IOManager* iom = hook_iomanager();
+    if(!iom)
+    {
+	return nanosleep_f(req,rem);
+    }
+    if(!req || req->tv_nsec < 0 || req->tv_nsec >= 1000000000 || req->tv_sec < 0)
+    {
+	errno = EINVAL;
+	return -1;
+    }
+    hook_sleep(iom,std::chrono::seconds(req->tv_sec) + std::chrono::nanoseconds(req->tv_nsec));
+    return 0;
+}
+
+int socket(int domain, int type, int protocol)
+{
+    int fd = socket_f(domain,type,protocol);
+    if(fd == -1 || !is_hook_enable())
+    {
+	return fd;
+    }
+    FdCtx* ctx = FdManager::GetInstance()->get(fd,true);
+    // SOCK_NONBLOCK是用户自己要求的非阻塞
+    if(ctx && (type & SOCK_NONBLOCK))
+    {
+	ctx->setUserNonblock(true);
+    }
+    return fd;
+}
+
+int connect(int fd, const struct sockaddr* addr, socklen_t addrlen)
+{
+    FdCtx* ctx = FdManager::GetInstance()->get(fd);
+    if(!hook_managed(ctx))
+    {
+	return connect_f(fd,addr,addrlen);
+    }
+    IOManager* iom = hook_iomanager();
+    int n = connect_f(fd,addr,addrlen);
+    if(n == 0)
+    {
+	return 0;
+    }
+    else if(n != -1 || errno != EINPROGRESS)
+    {
+	return n;
+    }
+    // 连接超时使用SO_SNDTIMEO，超时返回ETIMEDOUT
+    if(wait_ready(iom,fd,IOManager::WRITE,ctx->getTimeout(SO_SNDTIMEO),ETIMEDOUT))
+    {
+	return -1;
+    }
+    int error = 0;
+    socklen_t len = sizeof(int);
+    if(getsockopt(fd,SOL_SOCKET,SO_ERROR,&error,&len) == -1)
+    {
+	return -1;
+    }
+    if(!error)
+    {
+	return 0;
+    }
+    errno = error;
+    return -1;
+}
+
+int accept(int s, struct sockaddr* addr, socklen_t* addrlen)
+{
+    int fd = do_io(s,accept_f,IOManager::READ,SO_RCVTIMEO,addr,addrlen);
+    // 等待期间可能迁移到没有开启hook的线程上，监听socket由hook接管时新连接也由hook接管
+    if(fd >= 0 && (is_hook_enable() || hook_managed(FdManager::GetInstance()->get(s))))
+    {
+	FdManager::GetInstance()->get(fd,true);
+    }
+    return fd;
+}
+
+ssize_t read(int fd, void* buf, size_t count)
+{
+    return do_io(fd,read_f,IOManager::READ,SO_RCVTIMEO,buf,count);
+}
+
+ssize_t recv(int sockfd, void* buf, size_t len, int flags)
+{
+    return do_io(sockfd,recv_f,IOManager::READ,SO_RCVTIMEO,buf,len,flags);
+}
+
+ssize_t write(int fd, const void* buf, size_t count)
+{
+    return do_io(fd,write_f,IOManager::WRITE,SO_SNDTIMEO,buf,count);
+}
+
+ssize_t send(int s, const void* msg, size_t len, int flags)
+{
+    return do_io(s,send_f,IOManager::WRITE,SO_SNDTIMEO,msg,len,flags);
+}
+
+int close(int fd)
+{
+    FdCtx* ctx = FdManager::GetInstance()->get(fd);
+    if(ctx)
+    {
+	// fd关闭后挂在它上面的协程需要被唤醒，否则永远等不到事件
+	IOManager* iom = IOManager::GetIOManager();
+	if(iom)
+	{
+	    iom->cancelAll(fd);
+	}
+	FdManager::GetInstance()->del(fd);
+    }
+    return close_f(fd);
+}
+
+int fcntl(int fd, int cmd, ...)
+{
+    va_list va;
+    va_start(va,cmd);
+    switch(cmd)
+    {
+	case F_SETFL:
+	{
+	    int arg = va_arg(va,int);
+	    va_end(va);
+	    FdCtx* ctx = FdManager::GetInstance()->get(fd);
+	    if(!ctx || !ctx->isSocket())
+	    {
+		return fcntl_f(fd,cmd,arg);
+	    }
+	    // 记录用户的设置，实际的O_NONBLOCK由hook决定
+	    ctx->setUserNonblock(arg & O_NONBLOCK);
+	    if(ctx->getSysNonblock())
+	    {
+		arg |= O_NONBLOCK;
+	    }
+	    else
+	    {
+		arg &= ~O_NONBLOCK;
+	    }
+	    return fcntl_f(fd,cmd,arg);
+	}
+	case F_GETFL:
+	{
+	    va_end(va);
+	    int arg = fcntl_f(fd,cmd);
+	    FdCtx* ctx = FdManager::GetInstance()->get(fd);
+	    if(arg == -1 || !ctx || !ctx->isSocket())
+	    {
+		return arg;
+	    }
+	    // 返回用户看到的阻塞状态
+	    return ctx->getUserNonblock() ? arg | O_NONBLOCK : arg & ~O_NONBLOCK;
+	}
+	case F_DUPFD:
+	case F_DUPFD_CLOEXEC:
+	case F_SETFD:
+	case F_SETOWN:
+	case F_SETSIG:
+	case F_SETLEASE:
+	case F_NOTIFY:
+#ifdef F_SETPIPE_SZ
+	case F_SETPIPE_SZ:
+#endif
+#ifdef F_ADD_SEALS
+	case F_ADD_SEALS:
+#endif
+	{
+	    int arg = va_arg(va,int);
+	    va_end(va);
+	    return fcntl_f(fd,cmd,arg);
+	}
+	case F_GETFD:
+	case F_GETOWN:
+	case F_GETSIG:
+	case F_GETLEASE:
+#ifdef F_GETPIPE_SZ
+	case F_GETPIPE_SZ:
+#endif
+#ifdef F_GET_SEALS
+	case F_GET_SEALS:
+#endif
+	{
+	    va_end(va);
+	    return fcntl_f(fd,cmd);
+	}
+	// 参数是指针的命令：F_GETLK/F_SETLK/F_SETLKW、F_OFD_*LK、F_GETOWN_EX/F_SETOWN_EX、*_RW_HINT等．
+	// 新增的int参数的命令要加到上面，否则会被当作指针读取
+	default:
+	{
+	    void* arg = va_arg(va,void*);
+	    va_end(va);
+	    return fcntl_f(fd,cmd,arg);
+	}
+    }
+}
+
+int ioctl(int d, unsigned long int request, ...)
+{
+    va_list va;
+    va_start(va,request);
+    void* arg = va_arg(va,void*);
+    va_end(va);
+    if(request == FIONBIO)
+    {
+	bool user_nonblock = !!*(int*)arg;
+	FdCtx* ctx = FdManager::GetInstance()->get(d);
+	if(ctx && ctx->isSocket())
+	{
+	    // 与fcntl一样只记录用户的设置
+	    ctx->setUserNonblock(user_nonblock);
+	    return 0;
+	}
+    }
+    return ioctl_f(d,request,arg);
+}
+
+int setsockopt(int sockfd, int level, int optname, const void* optval, socklen_t optlen)
+{
+    if(level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO) && optval)
+    {
+	FdCtx* ctx = FdManager::GetInstance()->get(sockfd);
+	if(ctx)
+	{
+	    const timeval* v = (const timeval*)optval;
+	    uint64_t ms = v->tv_sec * 1000 + v->tv_usec / 1000;
+	    // 0表示不超时
+	    ctx->setTimeout(optname,ms ? ms : (uint64_t)-1);
+	}
+    }
+    return setsockopt_f(sockfd,level,optname,optval,optlen);
+}
+}
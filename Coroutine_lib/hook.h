@@ -0,0 +1,73 @@
+/*
+ - File Name: hook.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Thu 22 Oct 2026 10:26:51 AM CST
+ */
+
+#ifndef _HOOK_H_
+#define _HOOK_H_
+
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+// 系统调用hook：用IOManager::setHookEnable在它的所有工作线程上开启（set_hook_enable只对当前线程），
+// 开启后在IOManager的协程中调用下列函数时，socket上的阻塞读写、accept、connect会在EAGAIN时
+// 通过addEvent挂起协程，sleep系列函数通过addTimer挂起协程，并遵守fd上的SO_RCVTIMEO/SO_SNDTIMEO．
+// hook接管的socket实际上是非阻塞的，在没有开启hook的线程上对它做阻塞调用时用poll等待，保持阻塞语义．
+// 用户自己设置了O_NONBLOCK的fd保持原来的非阻塞语义．
+namespace Hourglass
+{
+// 当前线程设置了set_hook_enable，或者是开启了hook的IOManager的工作线程
+bool is_hook_enable();
+void set_hook_enable(bool flag);
+}
+
+extern "C"
+{
+// 原始的系统调用，hook内部与需要绕过hook的代码使用
+typedef unsigned int (*sleep_fun)(unsigned int seconds);
+extern sleep_fun sleep_f;
+
+typedef int (*usleep_fun)(useconds_t usec);
+extern usleep_fun usleep_f;
+
+typedef int (*nanosleep_fun)(const struct timespec* req, struct timespec* rem);
+extern nanosleep_fun nanosleep_f;
+
+typedef int (*socket_fun)(int domain, int type, int protocol);
+extern socket_fun socket_f;
+
+typedef int (*connect_fun)(int sockfd, const struct sockaddr* addr, socklen_t addrlen);
+extern connect_fun connect_f;
+
+typedef int (*accept_fun)(int s, struct sockaddr* addr, socklen_t* addrlen);
+extern accept_fun accept_f;
+
+typedef ssize_t (*read_fun)(int fd, void* buf, size_t count);
+extern read_fun read_f;
+
+typedef ssize_t (*recv_fun)(int sockfd, void* buf, size_t len, int flags);
+extern recv_fun recv_f;
+
+typedef ssize_t (*write_fun)(int fd, const void* buf, size_t count);
+extern write_fun write_f;
+
+typedef ssize_t (*send_fun)(int s, const void* msg, size_t len, int flags);
+extern send_fun send_f;
+
+typedef int (*close_fun)(int fd);
+extern close_fun close_f;
+
+typedef int (*fcntl_fun)(int fd, int cmd, ...);
+extern fcntl_fun fcntl_f;
+
+typedef int (*ioctl_fun)(int d, unsigned long int request, ...);
+extern ioctl_fun ioctl_f;
+
+typedef int (*setsockopt_fun)(int sockfd, int level, int optname, const void* optval, socklen_t optlen);
+extern setsockopt_fun setsockopt_f;
+}
+#endif
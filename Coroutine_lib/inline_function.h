@@ -0,0 +1,155 @@
+/*
+ - File Name: inline_function.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Mon 02 Nov 2026 09:21:54 AM CST
+ */
+
+#ifndef _INLINE_FUNCTION_H_
+#define _INLINE_FUNCTION_H_
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Hourglass
+{
+// 只能移动的 void() 函数对象，代替任务和协程中的std::function．
+// 不超过INLINE_SIZE字节、对齐不超过INLINE_ALIGN且移动不抛异常的函数对象直接放在内部，不分配堆内存
+// （std::function超过16字节的捕获就要分配）；更大的才放到堆上．函数对象也不需要可以拷贝
+class InlineFunction
+{
+public:
+    static const size_t INLINE_SIZE = 112;
+    static const size_t INLINE_ALIGN = 16;
+
+private:
+    struct Ops
+    {
+	void (*invoke)(void* storage);
+	// 把src中的对象移动到dst，并析构src中的对象
+	void (*move)(void* dst, void* src);
+	void (*destroy)(void* storage);
+	bool inlined;
+    };
+
+    template <class F>
+    struct InlineOps
+    {
+	static void invoke(void* storage) {(*static_cast<F*>(storage))();}
+	static void move(void* dst, void* src)
+	{
+	    F* from = static_cast<F*>(src);
+	    ::new(dst) F(std::move(*from));
+	    from->~F();
+	}
+	static void destroy(void* storage) {static_cast<F*>(storage)->~F();}
+	static constexpr Ops ops = {&invoke, &move, &destroy, true};
+    };
+
+    // 内部只存放指向堆上对象的指针
+    template <class F>
+    struct HeapOps
+    {
+	static F* get(void* storage) {return *static_cast<F**>(storage);}
+	static void invoke(void* storage) {(*get(storage))();}
+	static void move(void* dst, void* src) {::new(dst) F*(get(src));}
+	static void destroy(void* storage) {delete get(storage);}
+	static constexpr Ops ops = {&invoke, &move, &destroy, false};
+    };
+
+    alignas(INLINE_ALIGN) unsigned char m_storage[INLINE_SIZE];
+    const Ops* m_ops = nullptr;
+
+    // 空的std::function和空函数指针构造出空的InlineFunction
+    template <class F>
+    static bool isNull(const F&) {return false;}
+    template <class F>
+    static bool isNull(F* f) {return f == nullptr;}
+    static bool isNull(const std::function<void()>& f) {return !f;}
+
+public:
+    InlineFunction() noexcept {}
+    InlineFunction(std::nullptr_t) noexcept {}
+
+    template <class F, class D = typename std::decay<F>::type,
+	class = typename std::enable_if<!std::is_same<D,InlineFunction>::value>::type>
+    InlineFunction(F&& f)
+    {
+	if(isNull(f))
+	{
+	    return;
+	}
+	if constexpr(sizeof(D) <= INLINE_SIZE && alignof(D) <= INLINE_ALIGN && std::is_nothrow_move_constructible<D>::value)
+	{
+	    ::new((void*)m_storage) D(std::forward<F>(f));
+	    m_ops = &InlineOps<D>::ops;
+	}
+	else
+	{
+	    ::new((void*)m_storage) D*(new D(std::forward<F>(f)));
+	    m_ops = &HeapOps<D>::ops;
+	}
+    }
+
+    InlineFunction(InlineFunction&& other) noexcept
+    {
+	if(other.m_ops)
+	{
+	    other.m_ops->move(m_storage,other.m_storage);
+	    m_ops = other.m_ops;
+	    other.m_ops = nullptr;
+	}
+    }
+
+    InlineFunction& operator=(InlineFunction&& other) noexcept
+    {
+	if(this != &other)
+	{
+	    reset();
+	    if(other.m_ops)
+	    {
+		other.m_ops->move(m_storage,other.m_storage);
+		m_ops = other.m_ops;
+		other.m_ops = nullptr;
+	    }
+	}
+	return *this;
+    }
+
+    InlineFunction& operator=(std::nullptr_t) noexcept
+    {
+	reset();
+	return *this;
+    }
+
+    InlineFunction(const InlineFunction&) = delete;
+    InlineFunction& operator=(const InlineFunction&) = delete;
+
+    ~InlineFunction() {reset();}
+
+    void reset() noexcept
+    {
+	if(m_ops)
+	{
+	    m_ops->destroy(m_storage);
+	    m_ops = nullptr;
+	}
+    }
+
+    explicit operator bool() const noexcept {return m_ops != nullptr;}
+
+    void operator()()
+    {
+	assert(m_ops);
+	m_ops->invoke(m_storage);
+    }
+
+    // 函数对象是否放在内部（空的也算）
+    bool isInline() const noexcept {return !m_ops || m_ops->inlined;}
+};
+}
+#endif
@@ -6,13 +6,80 @@
  */
 
 #include "ioscheduler.h"
+#include "trace.h"
 #include <unistd.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <cstring>
+#include <algorithm>
 
 namespace Hourglass
 {
+// io_uring的SQ大小；排队的SQE达到URING_BATCH个时由提交者直接提交，否则在提交者让出后由afterTask提交
+// （同一时刻在不同线程上排队的SQE仍合并为一次io_uring_enter）
+static const unsigned URING_ENTRIES = 256;
+static const unsigned URING_BATCH = 32;
+// 每个线程缓存的空闲UringRequest个数上限．协程可能在另一个线程上恢复并释放请求，缓存满了直接释放，不会无限增长
+static const size_t URING_REQUEST_CACHE = 64;
+
+struct UringRequestNode
+{
+    UringRequestNode* next;
+};
+
+struct UringRequestCache
+{
+    UringRequestNode* head = nullptr;
+    size_t count = 0;
+
+    ~UringRequestCache()
+    {
+	while(head)
+	{
+	    UringRequestNode* next = head->next;
+	    ::operator delete(head);
+	    head = next;
+	}
+    }
+};
+
+static thread_local UringRequestCache t_uringRequestCache;
+
+void* IOManager::UringRequest::operator new(size_t size)
+{
+    assert(size == sizeof(UringRequest));
+    UringRequestCache& cache = t_uringRequestCache;
+    if(!cache.head)
+    {
+	return ::operator new(std::max(size,sizeof(UringRequestNode)));
+    }
+    UringRequestNode* node = cache.head;
+    cache.head = node->next;
+    cache.count--;
+    return node;
+}
+
+void IOManager::UringRequest::operator delete(void* ptr)
+{
+    if(!ptr)
+    {
+	return;
+    }
+    UringRequestCache& cache = t_uringRequestCache;
+    if(cache.count >= URING_REQUEST_CACHE)
+    {
+	::operator delete(ptr);
+	return;
+    }
+    UringRequestNode* node = static_cast<UringRequestNode*>(ptr);
+    node->next = cache.head;
+    cache.head = node;
+    cache.count++;
+}
+
 IOManager::FdContext::EventContext& IOManager::FdContext::getEventContext(Event event)
 {
     assert(event == READ || event == WRITE);
@@ -33,12 +100,27 @@ void IOManager::FdContext::resetEventContext(EventContext & ectx)
     ectx.func = nullptr;
 }
 
-void IOManager::FdContext::triggerEvent(Event event)
+void IOManager::FdContext::triggerEvent(Event event, TriggerBatch* batch)
 {
     assert(events & event);
     events = (Event)(events & ~event);
     EventContext& ctx = getEventContext(event);
-    if(ctx.func)
+    if(Tracer::isEnabled())
+    {
+	Tracer::record(Tracer::EVENT_TRIGGER,ctx.coroutine ? ctx.coroutine->getID() : (uint64_t)-1,fd,event);
+    }
+    if(batch && ctx.scheduler == batch->scheduler)
+    {
+	if(ctx.func)
+	{
+	    batch->funcs.push_back(std::move(ctx.func));
+	}
+	else
+	{
+	    batch->coroutines.push_back(std::move(ctx.coroutine));
+	}
+    }
+    else if(ctx.func)
     {
 	ctx.scheduler->schedulerLock(&ctx.func);
     }
@@ -50,87 +132,152 @@ void IOManager::FdContext::triggerEvent(Event event)
     return ;
 }
 
-IOManager::IOManager(size_t threads, bool use_caller,const std::string& name):Scheduler(threads,use_caller,name),TimerManager()
+static void epollAdd(int epfd, int fd, uint32_t events)
 {
-    m_epfd = epoll_create(5000);
-    assert(m_epfd > 0);
-    int rt = pipe(m_tickleFds);
-    assert(!rt);
     epoll_event event;
-    event.events = EPOLLIN | EPOLLET;
-    event.data.fd = m_tickleFds[0];
-    rt = fcntl(m_tickleFds[0],F_SETFL,O_NONBLOCK);
+    event.events = events;
+    event.data.fd = fd;
+    int rt = epoll_ctl(epfd,EPOLL_CTL_ADD,fd,&event);
     assert(!rt);
-    rt = epoll_ctl(m_epfd,EPOLL_CTL_ADD,m_tickleFds[0],&event);
-    assert(!rt);
-    contextResize(32);
-    start();
+    (void)rt;
 }
 
-void IOManager::contextResize(size_t size)
+IOManager::IOManager(size_t threads, bool use_caller,const std::string& name,TimerManager::Backend timer_backend,IOBackend io_backend,ReactorMode reactor_mode):Scheduler(threads,use_caller,name),TimerManager(timer_backend),m_ioBackend(io_backend),m_reactorMode(reactor_mode)
 {
-    m_fdcontext.resize(size);
-    for(size_t i = 0;i < m_fdcontext.size();++i)
+    m_timerFd = timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK | TFD_CLOEXEC);
+    assert(m_timerFd >= 0);
+    if(m_ioBackend == IO_URING && !m_uring.init(URING_ENTRIES))
+    {
+	std::cerr << "io_uring unavailable: " << strerror(errno) << ", falling back to epoll" << std::endl;
+	m_ioBackend = EPOLL;
+    }
+    if(m_reactorMode == SHARED_REACTOR)
     {
-	if(m_fdcontext[i] == nullptr)
+	m_epfd = epoll_create(5000);
+	assert(m_epfd > 0);
+	m_tickleFd = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+	assert(m_tickleFd >= 0);
+	epollAdd(m_epfd,m_tickleFd,EPOLLIN | EPOLLET);
+	epollAdd(m_epfd,m_timerFd,EPOLLIN | EPOLLET);
+	if(m_ioBackend == IO_URING)
+	{
+	    // 完成队列非空时ring的fd可读，poller由此被唤醒
+	    epollAdd(m_epfd,m_uring.getFd(),EPOLLIN);
+	}
+    }
+    for(size_t i = 0;i < getWorkerCount();i++)
+    {
+	m_parkers.emplace_back(new Parker());
+	Parker* parker = m_parkers[i].get();
+	parker->wakeFd = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+	assert(parker->wakeFd >= 0);
+	if(m_reactorMode == SHARED_REACTOR)
+	{
+	    continue;
+	}
+	parker->epfd = epoll_create1(EPOLL_CLOEXEC);
+	assert(parker->epfd >= 0);
+	epollAdd(parker->epfd,parker->wakeFd,EPOLLIN | EPOLLET);
+	// timerfd和ring的fd注册在每个reactor上，EPOLLEXCLUSIVE保证一次就绪只唤醒一个空闲线程
+	epollAdd(parker->epfd,m_timerFd,EPOLLIN | EPOLLET | EPOLLEXCLUSIVE);
+	if(m_ioBackend == IO_URING)
 	{
-	    m_fdcontext[i] = new FdContext();
-	    m_fdcontext[i]->fd = i;
+	    epollAdd(parker->epfd,m_uring.getFd(),EPOLLIN | EPOLLEXCLUSIVE);
 	}
     }
+    start();
+}
+
+IOManager::FdContext* IOManager::getFdContext(int fd, bool create)
+{
+    return fd < 0 ? nullptr : m_fdcontext.get(fd,create);
 }
 
 IOManager::~IOManager()
 {
     stop();
-    close(m_epfd);
-    close(m_tickleFds[0]);
-    close(m_tickleFds[1]);
-    for(size_t i = 0;i < m_fdcontext.size();++i)
+    if(m_epfd >= 0)
     {
-	if(m_fdcontext[i])
+	close(m_epfd);
+	close(m_tickleFd);
+    }
+    close(m_timerFd);
+    for(auto& parker : m_parkers)
+    {
+	close(parker->wakeFd);
+	if(parker->epfd >= 0)
 	{
-	    delete m_fdcontext[i];
+	    close(parker->epfd);
 	}
     }
 }
 
 int IOManager::addEvent(int fd,Event event,std::function<void()> func)
 {
-    FdContext *fd_ctx = nullptr;
-    std::shared_lock<std::shared_mutex> read_lock(m_mutex);
-    if((int)m_fdcontext.size() > fd)
-    {
-	fd_ctx = m_fdcontext[fd];
-	read_lock.unlock();
-    }
-    else
+    return addEvent(fd,event,std::move(func),0,nullptr,nullptr);
+}
+
+int IOManager::addEvent(int fd, Event event, std::function<void()> func, int64_t deadline, int* result, bool* at_front)
+{
+    FdContext *fd_ctx = getFdContext(fd,true);
+    if(!fd_ctx)
     {
-	read_lock.unlock();
-	std::unique_lock<std::shared_mutex> write_lock(m_mutex);
-	contextResize(fd * 1.5);
-	fd_ctx = m_fdcontext[fd];
+	std::cerr << "addEvent: fd " << fd << " out of range" << std::endl;
+	return -1;
     }
-    std::lock_guard<std::mutex> lock(fd_ctx->mutex);
+    std::lock_guard<SpinLock> lock(fd_ctx->mutex);
     if(fd_ctx->events & event)
     {
 	return -1;
     }
-    int op = fd_ctx->events? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
-    epoll_event epevent;
-    epevent.events = EPOLLIN | fd_ctx->events | event;
-    epevent.data.ptr = fd_ctx;
-    int rt = epoll_ctl(m_epfd,op,fd,&epevent);
-    if(rt)
+    if(m_reactorMode != SHARED_REACTOR && fd_ctx->reactor == -1)
     {
-	std::cerr << "addEvent::epoll_ctl failed: " << strerror(errno) << std::endl;
-	return -1;
+	fd_ctx->reactor = pickReactor(fd);
+    }
+    if(fd_ctx->registered)
+    {
+	// 持久注册的fd：边沿已经到过且还没有被消费，不用等待
+	if(fd_ctx->ready & event)
+	{
+	    fd_ctx->ready &= ~event;
+	    if(!func)
+	    {
+		return 1;
+	    }
+	    schedulerLock(std::move(func));
+	    return 0;
+	}
+    }
+    else if(m_persistentEvents)
+    {
+	// 读写同时以边沿触发注册，之后一直留在epoll中
+	if(epollCtl(epollFd(fd_ctx),EPOLL_CTL_ADD,fd_ctx,EPOLLIN | EPOLLOUT | EPOLLET))
+	{
+	    std::cerr << "addEvent::epoll_ctl failed: " << strerror(errno) << std::endl;
+	    return -1;
+	}
+	fd_ctx->registered = true;
+    }
+    else
+    {
+	int op = fd_ctx->events? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	if(epollCtl(epollFd(fd_ctx),op,fd_ctx,EPOLLIN | fd_ctx->events | event))
+	{
+	    std::cerr << "addEvent::epoll_ctl failed: " << strerror(errno) << std::endl;
+	    return -1;
+	}
     }
     ++m_pendingEventCount;
+    if(m_reactorMode != SHARED_REACTOR && inWorker() && getWorkerIndex() != fd_ctx->reactor)
+    {
+	// 事件就绪后在fd所属reactor的线程上恢复
+	m_reactorHandoffs.fetch_add(1,std::memory_order_relaxed);
+    }
     fd_ctx->events = (Event)(fd_ctx->events | event);
     FdContext::EventContext& event_ctx = fd_ctx->getEventContext(event);
     assert(!event_ctx.scheduler && !event_ctx.coroutine && !event_ctx.func);
     event_ctx.scheduler = Scheduler::GetThis();
+    event_ctx.seq++;
     if(func)
     {
 	event_ctx.func.swap(func);
@@ -140,137 +287,506 @@ int IOManager::addEvent(int fd,Event event,std::function<void()> func)
 	event_ctx.coroutine = Coroutine::getCoroutine();
 	assert(event_ctx.coroutine->getState() == Coroutine::RUNNING);
     }
+    if(Tracer::isEnabled())
+    {
+	Tracer::record(Tracer::EVENT_WAIT,event_ctx.coroutine ? event_ctx.coroutine->getID() : (uint64_t)-1,fd,event);
+    }
+    if(deadline)
+    {
+	bool front = pushEventDeadline({deadline,fd_ctx,event,event_ctx.seq,result});
+	if(at_front)
+	{
+	    *at_front = front;
+	}
+    }
     return 0;
 }
 
-bool IOManager::delEvent(int fd,Event event)
+int IOManager::waitEvent(int fd, Event event, std::chrono::steady_clock::time_point deadline)
 {
-    FdContext* fd_ctx = nullptr;
-    std::shared_lock<std::shared_mutex> read_lock(m_mutex);
-    if((int)m_fdcontext.size() > fd)
+    int result = EVENT_READY;
+    bool at_front = false;
+    int64_t ns = 0;
+    if(deadline != std::chrono::steady_clock::time_point::max())
     {
-	fd_ctx = m_fdcontext[fd];
-	read_lock.unlock();
+	// 0表示不超时，已经过去的截止时间也至少是1
+	ns = std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count(),1);
     }
-    else
+    int rt = addEvent(fd,event,nullptr,ns,&result,&at_front);
+    if(rt < 0)
+    {
+	return -1;
+    }
+    // 返回1时事件已经就绪，不用挂起
+    if(rt == 1)
+    {
+	return EVENT_READY;
+    }
+    if(at_front)
+    {
+	onTimerInsertAtFront();
+    }
+    Coroutine::getCoroutine()->yield();
+    return result;
+}
+
+bool IOManager::delEvent(int fd,Event event)
+{
+    FdContext* fd_ctx = getFdContext(fd,false);
+    if(!fd_ctx)
     {
-	read_lock.unlock();
 	return false;
     }
-    std::lock_guard<std::mutex> lock(fd_ctx->mutex);
+    std::lock_guard<SpinLock> lock(fd_ctx->mutex);
     if(!(fd_ctx->events & event))
     {
 	return false;
     }
     Event new_events = (Event)(fd_ctx->events & ~event);
-    int op = new_events? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-    epoll_event epevent;
-    epevent.events = EPOLLET | new_events;
-    epevent.data.ptr = fd_ctx;
-    int rt = epoll_ctl(m_epfd,op,fd,&epevent);
-    if(rt)
+    // 持久注册的fd一直留在epoll中，只需要修改等待的事件
+    if(!fd_ctx->registered)
     {
-	std::cerr << "delEvent::epoll_ctl failed: " << strerror(errno) << std::endl;
-	return -1;
+	int op = new_events? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+	if(epollCtl(epollFd(fd_ctx),op,fd_ctx,EPOLLET | new_events))
+	{
+	    std::cerr << "delEvent::epoll_ctl failed: " << strerror(errno) << std::endl;
+	    return -1;
+	}
     }
     --m_pendingEventCount;
     fd_ctx->events = new_events;
     FdContext::EventContext& event_ctx = fd_ctx->getEventContext(event);
+    removeEventDeadline(event_ctx);
     fd_ctx->resetEventContext(event_ctx);
     return true;
 }
 
 bool IOManager::cancelEvent(int fd, Event event)
 {
-    FdContext* fd_ctx = nullptr;
-    std::shared_lock<std::shared_mutex> read_lock(m_mutex);
-    if((int)m_fdcontext.size() > fd)
+    FdContext* fd_ctx = getFdContext(fd,false);
+    if(!fd_ctx)
     {
-	fd_ctx = m_fdcontext[fd];
-	read_lock.unlock();
-    }
-    else
-    {
-	read_lock.unlock();
 	return false;
     }
-    std::lock_guard<std::mutex> lock(fd_ctx->mutex);
+    std::lock_guard<SpinLock> lock(fd_ctx->mutex);
+    return cancelEventLocked(fd_ctx,event);
+}
+
+bool IOManager::cancelEventLocked(FdContext* fd_ctx, Event event, FdContext::TriggerBatch* batch)
+{
     if(!(fd_ctx->events & event))
     {
 	return false;
     }
     Event new_events = (Event)(fd_ctx->events & ~event);
-    int op = new_events? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-    epoll_event epevent;
-    epevent.events = EPOLLET | new_events;
-    epevent.data.ptr = fd_ctx;
-    int rt = epoll_ctl(m_epfd,op,fd,&epevent);
-    if(rt)
+    // 持久注册的fd一直留在epoll中，只需要修改等待的事件
+    if(!fd_ctx->registered)
     {
-	std::cerr << "cacelEvent::epoll_ctl failed: " << strerror(errno) << std::endl;
-	return -1;
+	int op = new_events? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+	if(epollCtl(epollFd(fd_ctx),op,fd_ctx,EPOLLET | new_events))
+	{
+	    std::cerr << "cacelEvent::epoll_ctl failed: " << strerror(errno) << std::endl;
+	    return -1;
+	}
     }
-    --m_pendingEventCount;
-    fd_ctx->triggerEvent(event);
+    finishEvent(fd_ctx,event,batch);
     return true;
 }
 
+void IOManager::finishEvent(FdContext* fd_ctx, Event event, FdContext::TriggerBatch* batch)
+{
+    removeEventDeadline(fd_ctx->getEventContext(event));
+    fd_ctx->triggerEvent(event,batch);
+    --m_pendingEventCount;
+}
+
 bool IOManager::cancelAll(int fd)
 {
-    FdContext *fd_ctx = nullptr;
-    std::shared_lock<std::shared_mutex> read_lock(m_mutex);
-    if((int)m_fdcontext.size() > fd)
-    {
-	fd_ctx = m_fdcontext[fd];
-	read_lock.unlock();
-    }
-    else
+    FdContext* fd_ctx = getFdContext(fd,false);
+    if(!fd_ctx)
     {
-	read_lock.unlock();
 	return false;
     }
-    std::lock_guard<std::mutex> lock(fd_ctx->mutex);
-    if(!fd_ctx->events)
+    std::lock_guard<SpinLock> lock(fd_ctx->mutex);
+    if(!fd_ctx->events && !fd_ctx->registered)
     {
 	return false;
     }
-    int op = EPOLL_CTL_DEL;
-    epoll_event epevent;
-    epevent.events = 0;
-    epevent.data.ptr = fd_ctx;
-    int rt = epoll_ctl(m_epfd,op,fd,&epevent);
-    if(rt)
+    int rt = epollCtl(epollFd(fd_ctx),EPOLL_CTL_DEL,fd_ctx,0);
+    // 持久注册的fd如果已经被关闭，内核已经把它移出epoll，状态仍然需要清理
+    if(rt && !fd_ctx->registered)
     {
 	std::cerr << "IOManager::epoll_ctl failed: " << strerror(errno) << std::endl;
 	return -1;
     }
+    fd_ctx->registered = false;
+    fd_ctx->ready = NONE;
     if(fd_ctx->events & READ)
     {
-	fd_ctx->triggerEvent(READ);
-	--m_pendingEventCount;
+	finishEvent(fd_ctx,READ);
     }
     if(fd_ctx->events & WRITE)
     {
-	fd_ctx->triggerEvent(WRITE);
-	--m_pendingEventCount;
+	finishEvent(fd_ctx,WRITE);
     }
     assert(fd_ctx->events == 0);
+    // fd号可能被新打开的文件复用，重新分配reactor
+    fd_ctx->reactor = -1;
     return true;
 }
 
+int IOManager::pickReactor(int fd) const
+{
+    // 主线程作为工作线程时只在stop()中才执行调度，它的epoll平时没有人等待，只在创建的线程中选择
+    int threads = (int)getThreadCount();
+    if(threads == 0)
+    {
+	return 0;
+    }
+    int index = m_reactorMode == THREAD_REACTOR ? getWorkerIndex() : -1;
+    return index != -1 && index < threads ? index : fd % threads;
+}
+
+bool IOManager::setFdReactor(int fd, int index)
+{
+    int threads = getThreadCount() ? (int)getThreadCount() : 1;
+    if(m_reactorMode == SHARED_REACTOR || index < 0 || index >= threads)
+    {
+	return false;
+    }
+    FdContext* fd_ctx = getFdContext(fd,true);
+    if(!fd_ctx)
+    {
+	return false;
+    }
+    std::lock_guard<SpinLock> lock(fd_ctx->mutex);
+    // 已经注册在原来的epoll上，等事件都完成（持久注册的fd要等cancelAll）后再移动
+    if(fd_ctx->events || fd_ctx->registered)
+    {
+	return false;
+    }
+    fd_ctx->reactor = index;
+    return true;
+}
+
+int IOManager::epollCtl(int epfd, int op, FdContext* fd_ctx, uint32_t events)
+{
+    epoll_event epevent;
+    epevent.events = events;
+    epevent.data.ptr = fd_ctx;
+    m_epollCtlCalls.fetch_add(1,std::memory_order_relaxed);
+    return epoll_ctl(epfd,op,fd_ctx->fd,&epevent);
+}
+
 IOManager* IOManager::GetIOManager()
 {
     return dynamic_cast<IOManager*>(Scheduler::GetThis());
 }
 
+int IOManager::uringCall(UringRequest* req, uint8_t opcode, int fd, uint64_t addr, uint32_t len, uint64_t off, uint32_t flags, uint64_t addr2)
+{
+    req->coroutine = Coroutine::getCoroutine();
+    {
+	std::lock_guard<std::mutex> lock(m_uringMutex);
+	io_uring_sqe* sqe = m_uring.getSqe();
+	if(!sqe)
+	{
+	    m_uring.flush();
+	    m_uringQueued = m_uring.pending();
+	    sqe = m_uring.getSqe();
+	}
+	if(!sqe)
+	{
+	    req->coroutine.reset();
+	    return -EBUSY;
+	}
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = addr;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->rw_flags = flags;
+	if(addr2)
+	{
+	    sqe->addr2 = addr2;
+	}
+	sqe->user_data = (uint64_t)req;
+	++m_pendingEventCount;
+	if(m_uring.pending() >= URING_BATCH)
+	{
+	    m_uring.flush();
+	}
+	m_uringQueued = m_uring.pending();
+    }
+    // 完成事件由poller取出后调度本协程
+    Coroutine::getCoroutine()->yield();
+    return req->result;
+}
+
+void IOManager::uringFlush()
+{
+    if(m_uringQueued == 0)
+    {
+	return;
+    }
+    std::lock_guard<std::mutex> lock(m_uringMutex);
+    int rt = m_uring.flush();
+    if(rt < 0 && rt != -EAGAIN && rt != -EBUSY)
+    {
+	std::cerr << "io_uring_enter failed: " << strerror(-rt) << std::endl;
+    }
+    m_uringQueued = m_uring.pending();
+}
+
+// io_uring的结果转换成系统调用的返回约定
+static inline int uringResult(int res)
+{
+    if(res < 0)
+    {
+	errno = -res;
+	return -1;
+    }
+    return res;
+}
+
+ssize_t IOManager::asyncRead(int fd, void* buf, size_t count, off_t offset)
+{
+    if(!inWorker())
+    {
+	return offset < 0 ? read(fd,buf,count) : pread(fd,buf,count,offset);
+    }
+    while(m_ioBackend == IO_URING)
+    {
+	std::unique_ptr<UringRequest> req(new UringRequest());
+	int res = uringCall(req.get(),IORING_OP_READ,fd,(uint64_t)buf,count,(uint64_t)offset,0);
+	// 非阻塞fd上没有数据时内核直接返回EAGAIN，等就绪后重新提交
+	if(res == -EAGAIN && waitEvent(fd,READ) == 0)
+	{
+	    continue;
+	}
+	return uringResult(res);
+    }
+    while(true)
+    {
+	ssize_t n = offset < 0 ? read(fd,buf,count) : pread(fd,buf,count,offset);
+	if(n >= 0 || errno != EAGAIN || waitEvent(fd,READ))
+	{
+	    return n;
+	}
+    }
+}
+
+ssize_t IOManager::asyncWrite(int fd, const void* buf, size_t count, off_t offset)
+{
+    if(!inWorker())
+    {
+	return offset < 0 ? write(fd,buf,count) : pwrite(fd,buf,count,offset);
+    }
+    while(m_ioBackend == IO_URING)
+    {
+	std::unique_ptr<UringRequest> req(new UringRequest());
+	int res = uringCall(req.get(),IORING_OP_WRITE,fd,(uint64_t)buf,count,(uint64_t)offset,0);
+	if(res == -EAGAIN && waitEvent(fd,WRITE) == 0)
+	{
+	    continue;
+	}
+	return uringResult(res);
+    }
+    while(true)
+    {
+	ssize_t n = offset < 0 ? write(fd,buf,count) : pwrite(fd,buf,count,offset);
+	if(n >= 0 || errno != EAGAIN || waitEvent(fd,WRITE))
+	{
+	    return n;
+	}
+    }
+}
+
+int IOManager::asyncAccept(int fd, sockaddr* addr, socklen_t* addrlen, int flags)
+{
+    if(!inWorker())
+    {
+	return accept4(fd,addr,addrlen,flags);
+    }
+    while(m_ioBackend == IO_URING)
+    {
+	std::unique_ptr<UringRequest> req(new UringRequest());
+	int res = uringCall(req.get(),IORING_OP_ACCEPT,fd,(uint64_t)addr,0,0,flags,(uint64_t)addrlen);
+	if(res == -EAGAIN && waitEvent(fd,READ) == 0)
+	{
+	    continue;
+	}
+	return uringResult(res);
+    }
+    while(true)
+    {
+	int n = accept4(fd,addr,addrlen,flags);
+	if(n >= 0 || errno != EAGAIN || waitEvent(fd,READ))
+	{
+	    return n;
+	}
+    }
+}
+
+int IOManager::asyncConnect(int fd, const sockaddr* addr, socklen_t addrlen)
+{
+    if(!inWorker())
+    {
+	return connect(fd,addr,addrlen);
+    }
+    int rt = 0;
+    if(m_ioBackend == IO_URING)
+    {
+	std::unique_ptr<UringRequest> req(new UringRequest());
+	rt = uringResult(uringCall(req.get(),IORING_OP_CONNECT,fd,(uint64_t)addr,0,addrlen,0));
+    }
+    else
+    {
+	rt = connect(fd,addr,addrlen);
+    }
+    // 非阻塞fd：等可写后从SO_ERROR取连接结果
+    if(rt == 0 || errno != EINPROGRESS || waitEvent(fd,WRITE))
+    {
+	return rt;
+    }
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if(getsockopt(fd,SOL_SOCKET,SO_ERROR,&error,&len))
+    {
+	return -1;
+    }
+    if(error)
+    {
+	errno = error;
+	return -1;
+    }
+    return 0;
+}
+
+int IOManager::asyncTimeout(std::chrono::nanoseconds timeout)
+{
+    if(!inWorker())
+    {
+	timespec ts;
+	ts.tv_sec = timeout.count() / 1000000000;
+	ts.tv_nsec = timeout.count() % 1000000000;
+	while(nanosleep(&ts,&ts) && errno == EINTR);
+	return 0;
+    }
+    if(m_ioBackend == IO_URING)
+    {
+	std::unique_ptr<UringRequest> req(new UringRequest());
+	req->timeout.tv_sec = timeout.count() / 1000000000;
+	req->timeout.tv_nsec = timeout.count() % 1000000000;
+	// 超时到达时结果为-ETIME，属于正常完成
+	uringCall(req.get(),IORING_OP_TIMEOUT,-1,(uint64_t)&req->timeout,1,0,0);
+	return 0;
+    }
+    std::shared_ptr<Coroutine> cor = Coroutine::getCoroutine();
+    addTimer(timeout,[this,cor](){schedulerLock(cor);});
+    cor->yield();
+    return 0;
+}
+
+bool IOManager::wakeWorker(size_t index)
+{
+    Parker* parker = m_parkers[index].get();
+    int state = parker->state;
+    // 先把状态改成RUNNING占住这个线程，连续多次唤醒会落到不同的线程上
+    if(state == RUNNING || !parker->state.compare_exchange_strong(state,RUNNING))
+    {
+	return false;
+    }
+    // 共用epoll时只有poller阻塞在epoll_wait上，写m_tickleFd唤醒的一定是它
+    int fd = state == FOLLOWER || m_reactorMode != SHARED_REACTOR ? parker->wakeFd : m_tickleFd;
+    uint64_t one = 1;
+    int rt = write(fd,&one,sizeof(one));
+    assert(rt == sizeof(one));
+    (void)rt;
+    m_wakeupSyscalls.fetch_add(1,std::memory_order_relaxed);
+    return true;
+}
+
+void IOManager::drainWakeFd(int fd)
+{
+    uint64_t value;
+    if(read(fd,&value,sizeof(value)) == sizeof(value))
+    {
+	m_wakeupSyscalls.fetch_add(1,std::memory_order_relaxed);
+    }
+}
+
+void IOManager::armTimerFd(std::chrono::steady_clock::time_point deadline)
+{
+    std::lock_guard<SpinLock> lock(m_timerFdMutex);
+    if(deadline == m_timerFdDeadline)
+    {
+	return;
+    }
+    // steady_clock与CLOCK_MONOTONIC同源，直接设置绝对时间
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    itimerspec spec = {};
+    spec.it_value.tv_sec = ns / 1000000000;
+    spec.it_value.tv_nsec = ns % 1000000000;
+    if(timerfd_settime(m_timerFd,TFD_TIMER_ABSTIME,&spec,nullptr))
+    {
+	std::cerr << "timerfd_settime failed: " << strerror(errno) << std::endl;
+	return;
+    }
+    m_timerFdDeadline = deadline;
+}
+
+void IOManager::drainTimerFd()
+{
+    std::lock_guard<SpinLock> lock(m_timerFdMutex);
+    uint64_t expirations;
+    while(read(m_timerFd,&expirations,sizeof(expirations)) > 0);
+    // 已经触发，下次需要重新设置
+    m_timerFdDeadline = std::chrono::steady_clock::time_point();
+}
+
+double IOManager::getWakeupSyscallsPerTask() const
+{
+    uint64_t tasks = getExecutedTasks();
+    return tasks ? (double)getWakeupSyscalls() / tasks : 0.0;
+}
+
 void IOManager::tickle()
 {
     if(!hasIdleThreads())
     {
+	m_coalescedWakeups.fetch_add(1,std::memory_order_relaxed);
 	return ;
     }
-    int rt = write(m_tickleFds[1],"T",1);
-    assert(rt == 1);
+    // 优先唤醒follower，不打断poller等待IO
+    int poller = -1;
+    for(size_t i = 0;i < m_parkers.size();i++)
+    {
+	int state = m_parkers[i]->state;
+	// 每线程reactor模式下各线程只等自己的epoll，唤醒任意一个即可
+	if((state == FOLLOWER || (state == POLLER && m_reactorMode != SHARED_REACTOR)) && wakeWorker(i))
+	{
+	    return;
+	}
+	if(state == POLLER)
+	{
+	    poller = i;
+	}
+    }
+    if(poller == -1 || !wakeWorker(poller))
+    {
+	// 空闲线程都已经被唤醒，合并掉这次唤醒
+	m_coalescedWakeups.fetch_add(1,std::memory_order_relaxed);
+    }
+}
+
+void IOManager::tickleThread(int thread)
+{
+    int index = getWorkerIndex(thread);
+    if(index != -1 && !wakeWorker(index))
+    {
+	m_coalescedWakeups.fetch_add(1,std::memory_order_relaxed);
+    }
 }
 
 bool IOManager::stopping()
@@ -279,23 +795,268 @@ bool IOManager::stopping()
     return timeout == ~0ull && m_pendingEventCount == 0 && Scheduler::stopping();
 }
 
+void IOManager::dispatchFdEvent(epoll_event& event, int epfd, FdContext::TriggerBatch* batch)
+{
+    FdContext *fd_ctx = (FdContext*)event.data.ptr;
+    std::lock_guard<SpinLock> lock(fd_ctx->mutex);
+    if(event.events & (EPOLLERR | EPOLLHUP))
+    {
+	event.events |= fd_ctx->registered ? (EPOLLIN | EPOLLOUT) : (EPOLLIN | EPOLLOUT) & fd_ctx->events;
+    }
+    int real_events = NONE;
+    if(event.events & EPOLLIN)
+    {
+	real_events |= READ;
+    }
+    if(event.events & EPOLLOUT)
+    {
+	real_events |= WRITE;
+    }
+    if(fd_ctx->registered)
+    {
+	// 持久注册：没有人等待的边沿记录下来，留给下一次addEvent
+	fd_ctx->ready |= real_events & ~fd_ctx->events;
+    }
+    // 非持久注册时EPOLLIN总是在监听集合里，只等写事件时到达的读事件不能当成读等待完成
+    real_events &= fd_ctx->events;
+    if(real_events == NONE)
+    {
+	return;
+    }
+    if(!fd_ctx->registered)
+    {
+	int left_events = (fd_ctx->events & ~real_events);
+	int op = left_events? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+	if(epollCtl(epfd,op,fd_ctx,EPOLLET | left_events))
+	{
+	    std::cerr << "idle::epoll_ctl failed: " << strerror(errno) <<std::endl;
+	    return;
+	}
+    }
+    if(real_events & READ)
+    {
+	finishEvent(fd_ctx,READ,batch);
+    }
+    if(real_events & WRITE)
+    {
+	finishEvent(fd_ctx,WRITE,batch);
+    }
+}
+
+void IOManager::deadlinePlace(size_t index, const EventDeadline& entry)
+{
+    m_eventDeadlines[index] = entry;
+    entry.fdCtx->getEventContext(entry.event).deadlineIndex.store((int)index,std::memory_order_relaxed);
+}
+
+void IOManager::deadlineSiftUp(size_t index)
+{
+    EventDeadline entry = m_eventDeadlines[index];
+    while(index > 0)
+    {
+	size_t parent = (index - 1) / 2;
+	if(m_eventDeadlines[parent].deadline <= entry.deadline)
+	{
+	    break;
+	}
+	deadlinePlace(index,m_eventDeadlines[parent]);
+	index = parent;
+    }
+    deadlinePlace(index,entry);
+}
+
+void IOManager::deadlineSiftDown(size_t index)
+{
+    EventDeadline entry = m_eventDeadlines[index];
+    size_t n = m_eventDeadlines.size();
+    while(true)
+    {
+	size_t child = index * 2 + 1;
+	if(child >= n)
+	{
+	    break;
+	}
+	if(child + 1 < n && m_eventDeadlines[child + 1].deadline < m_eventDeadlines[child].deadline)
+	{
+	    child++;
+	}
+	if(entry.deadline <= m_eventDeadlines[child].deadline)
+	{
+	    break;
+	}
+	deadlinePlace(index,m_eventDeadlines[child]);
+	index = child;
+    }
+    deadlinePlace(index,entry);
+}
+
+bool IOManager::pushEventDeadline(const EventDeadline& entry)
+{
+    std::lock_guard<SpinLock> lock(m_eventDeadlineMutex);
+    m_eventDeadlines.push_back(entry);
+    deadlineSiftUp(m_eventDeadlines.size() - 1);
+    m_eventDeadlineCount = m_eventDeadlines.size();
+    return entry.fdCtx->getEventContext(entry.event).deadlineIndex.load(std::memory_order_relaxed) == 0;
+}
+
+void IOManager::removeEventDeadline(FdContext::EventContext& ctx)
+{
+    // 没有截止时间的等待不用加锁
+    if(ctx.deadlineIndex.load(std::memory_order_relaxed) == -1)
+    {
+	return;
+    }
+    std::lock_guard<SpinLock> lock(m_eventDeadlineMutex);
+    int index = ctx.deadlineIndex.load(std::memory_order_relaxed);
+    if(index == -1)
+    {
+	return;
+    }
+    ctx.deadlineIndex.store(-1,std::memory_order_relaxed);
+    EventDeadline last = m_eventDeadlines.back();
+    m_eventDeadlines.pop_back();
+    m_eventDeadlineCount = m_eventDeadlines.size();
+    if((size_t)index < m_eventDeadlines.size())
+    {
+	// 用最后一个元素填上空位，再向上或向下调整
+	deadlinePlace(index,last);
+	deadlineSiftDown(index);
+	deadlineSiftUp(last.fdCtx->getEventContext(last.event).deadlineIndex.load(std::memory_order_relaxed));
+    }
+}
+
+void IOManager::expireEventDeadlines(FdContext::TriggerBatch& batch)
+{
+    if(m_eventDeadlineCount == 0)
+    {
+	return;
+    }
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    std::vector<EventDeadline> expired;
+    {
+	std::lock_guard<SpinLock> lock(m_eventDeadlineMutex);
+	while(!m_eventDeadlines.empty() && m_eventDeadlines[0].deadline <= now)
+	{
+	    EventDeadline& top = m_eventDeadlines[0];
+	    top.fdCtx->getEventContext(top.event).deadlineIndex.store(-1,std::memory_order_relaxed);
+	    expired.push_back(top);
+	    EventDeadline last = m_eventDeadlines.back();
+	    m_eventDeadlines.pop_back();
+	    if(!m_eventDeadlines.empty())
+	    {
+		deadlinePlace(0,last);
+		deadlineSiftDown(0);
+	    }
+	}
+	m_eventDeadlineCount = m_eventDeadlines.size();
+    }
+    // 放开堆的锁之后再加fd的锁；这期间事件可能已经触发，甚至开始了新的等待，用seq区分
+    for(EventDeadline& entry : expired)
+    {
+	FdContext* fd_ctx = entry.fdCtx;
+	std::lock_guard<SpinLock> lock(fd_ctx->mutex);
+	if(!(fd_ctx->events & entry.event) || fd_ctx->getEventContext(entry.event).seq != entry.seq)
+	{
+	    continue;
+	}
+	// 等待者还挂起着，结果在恢复之前写入
+	if(entry.result)
+	{
+	    *entry.result = EVENT_TIMEOUT;
+	}
+	cancelEventLocked(fd_ctx,entry.event,&batch);
+    }
+}
+
+std::chrono::steady_clock::time_point IOManager::nextDeadline()
+{
+    auto deadline = getNextDeadline();
+    if(m_eventDeadlineCount == 0)
+    {
+	return deadline;
+    }
+    std::lock_guard<SpinLock> lock(m_eventDeadlineMutex);
+    if(!m_eventDeadlines.empty())
+    {
+	std::chrono::steady_clock::time_point event_deadline{std::chrono::nanoseconds(m_eventDeadlines[0].deadline)};
+	deadline = std::min(deadline,event_deadline);
+    }
+    return deadline;
+}
+
+void IOManager::uringReap(FdContext::TriggerBatch& batch)
+{
+    if(!m_uringReapMutex.try_lock())
+    {
+	return;
+    }
+    m_uring.reap([this,&batch](uint64_t data,int res)
+    {
+	UringRequest* req = (UringRequest*)data;
+	req->result = res;
+	batch.coroutines.push_back(std::move(req->coroutine));
+	--m_pendingEventCount;
+    });
+    m_uringReapMutex.unlock();
+}
+
 void IOManager::idle() 
 {
+    if(m_reactorMode != SHARED_REACTOR)
+    {
+	reactorIdle();
+	return;
+    }
     static const uint64_t MAX_EVENTS = 256;
+    static const uint64_t MAX_TIMEOUT = 5000;
     std::unique_ptr<epoll_event[]> events(new epoll_event[MAX_EVENTS]);
+    Parker* me = m_parkers[getWorkerIndex()].get();
     while(true)
     {
 	if(stopping())
 	{
 	    break;
 	}
+	// 本线程跑过的协程排队的io_uring操作在这里一次性提交
+	uringFlush();
+	if(m_polling.exchange(true))
+	{
+	    // 已经有poller，阻塞在自己的管道上等待被精确唤醒
+	    // 先发布状态再检查任务，与提交任务后检查状态的tickle配对，避免错过唤醒
+	    me->state = FOLLOWER;
+	    bool readable = false;
+	    if(!hasPendingTask() && !stopping())
+	    {
+		pollfd pfd;
+		pfd.fd = me->wakeFd;
+		pfd.events = POLLIN;
+		readable = poll(&pfd,1,MAX_TIMEOUT) > 0;
+	    }
+	    // 状态已经被改成RUNNING说明有人认领了这个线程并写了eventfd
+	    if(me->state.exchange(RUNNING) == RUNNING || readable)
+	    {
+		drainWakeFd(me->wakeFd);
+	    }
+	    Coroutine::getCoroutine()->yield();
+	    continue;
+	}
+	me->state = POLLER;
 	int rt = 0;
-	while(true)
+	while(!hasPendingTask())
 	{
-	    static const uint64_t MAX_TIMEOUT = 5000;
-	    uint64_t next_timeout = getNextTimer();
-	    next_timeout = std::min(next_timeout,MAX_TIMEOUT);
-	    rt = epoll_wait(m_epfd,events.get(),MAX_EVENTS,(int)next_timeout);
+	    // 定时器由timerfd按纳秒精度唤醒，epoll_wait的超时只作为兜底
+	    int timeout = MAX_TIMEOUT;
+	    auto deadline = nextDeadline();
+	    if(deadline <= std::chrono::steady_clock::now())
+	    {
+		timeout = 0;
+	    }
+	    else if(deadline != std::chrono::steady_clock::time_point::max())
+	    {
+		armTimerFd(deadline);
+	    }
+	    rt = epoll_wait(m_epfd,events.get(),MAX_EVENTS,timeout);
+	    me->stats.epollWaits.add();
 	    if(rt < 0 && errno == EINTR)
 	    {
 		continue;
@@ -305,70 +1066,194 @@ void IOManager::idle()
 		break;
 	    }
 	}
-	std::vector<std::function<void()>> funcs;
-	listExpiredFunc(funcs);
-	if(!funcs.empty())
+	me->state = RUNNING;
+	if(rt > 0)
 	{
-	    for(const auto& func : funcs)
-	    {
-		schedulerLock(func);
-	    }
-	    funcs.clear();
+	    me->stats.epollEvents.add(rt);
 	}
+	FdContext::TriggerBatch batch;
+	batch.scheduler = this;
+	if(m_ioBackend == IO_URING)
+	{
+	    // 完成队列由poller读取，必须在交出poller之前取完
+	    uringReap(batch);
+	}
+	m_polling = false;
+	listExpiredFunc(batch.funcs);
+	expireEventDeadlines(batch);
 	for(int i = 0;i < rt;++i)
 	{
 	    epoll_event& event = events[i];
-	    if(event.data.fd == m_tickleFds[0])
+	    if(event.data.fd == m_tickleFd)
+	    {
+		drainWakeFd(m_tickleFd);
+		continue;
+	    }
+	    if(m_ioBackend == IO_URING && event.data.fd == m_uring.getFd())
+	    {
+		continue;
+	    }
+	    if(event.data.fd == m_timerFd)
 	    {
-		uint8_t dummy[256];
-		while(read(m_tickleFds[0],dummy,sizeof(dummy)) > 0);
+		drainTimerFd();
 		continue;
 	    }
-	    FdContext *fd_ctx = (FdContext*)event.data.ptr;
-	    std::lock_guard<std::mutex> lock(fd_ctx->mutex);
-	    if(event.events & (EPOLLERR | EPOLLHUP))
+	    dispatchFdEvent(event,m_epfd,&batch);
+	}
+	// 到期的定时器和就绪的事件一次性提交
+	schedulerBatch(std::make_move_iterator(batch.funcs.begin()),std::make_move_iterator(batch.funcs.end()));
+	schedulerBatch(std::make_move_iterator(batch.coroutines.begin()),std::make_move_iterator(batch.coroutines.end()));
+	// 交出poller之后让一个follower接着等待IO和定时器
+	for(size_t i = 0;i < m_parkers.size();i++)
+	{
+	    if(m_parkers[i].get() != me && wakeWorker(i))
+	    {
+		break;
+	    }
+	}
+	Coroutine::getCoroutine()->yield();
+    }
+}
+
+void IOManager::reactorIdle()
+{
+    static const uint64_t MAX_EVENTS = 256;
+    static const uint64_t MAX_TIMEOUT = 5000;
+    std::unique_ptr<epoll_event[]> events(new epoll_event[MAX_EVENTS]);
+    Parker* me = m_parkers[getWorkerIndex()].get();
+    while(true)
+    {
+	if(stopping())
+	{
+	    break;
+	}
+	uringFlush();
+	// 先发布状态再检查任务，与提交任务后检查状态的tickle配对，避免错过唤醒
+	me->state = POLLER;
+	int rt = 0;
+	if(!hasPendingTask() && !stopping())
+	{
+	    // 最近的定时器已经到期时不阻塞，否则由timerfd按时唤醒某个空闲线程
+	    int timeout = MAX_TIMEOUT;
+	    auto deadline = nextDeadline();
+	    if(deadline <= std::chrono::steady_clock::now())
 	    {
-		event.events |= (EPOLLIN | EPOLLOUT) & fd_ctx->events;
+		timeout = 0;
 	    }
-	    int real_events = NONE;
-	    if(event.events & EPOLLIN)
+	    else if(deadline != std::chrono::steady_clock::time_point::max())
 	    {
-		real_events |= READ;
+		armTimerFd(deadline);
 	    }
-	    if(event.events & EPOLLOUT)
+	    rt = epoll_wait(me->epfd,events.get(),MAX_EVENTS,timeout);
+	    me->stats.epollWaits.add();
+	    if(rt < 0)
 	    {
-		real_events |= WRITE;
+		rt = 0;
 	    }
-	    if((fd_ctx->events & real_events) == NONE)
+	    me->stats.epollEvents.add(rt);
+	}
+	me->state = RUNNING;
+	// 定时器和io_uring的完成可以在任意线程上运行
+	FdContext::TriggerBatch batch;
+	batch.scheduler = this;
+	// 本reactor上就绪的fd固定在本线程上恢复，不会被其他线程窃取；
+	// 已经绑定到其他线程的共享栈协程由SchedulerTask改回它绑定的线程
+	FdContext::TriggerBatch local;
+	local.scheduler = this;
+	local.thread = Thread::GetThreadID();
+	bool timer_fired = false;
+	for(int i = 0;i < rt;++i)
+	{
+	    epoll_event& event = events[i];
+	    if(event.data.fd == me->wakeFd)
 	    {
+		drainWakeFd(me->wakeFd);
 		continue;
 	    }
-	    int left_events = (fd_ctx->events & ~real_events);
-	    int op = left_events? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-	    event.events = EPOLLET | left_events;
-	    int rt2 = epoll_ctl(m_epfd,op,fd_ctx->fd,&event);
-	    if(rt2)
+	    if(m_ioBackend == IO_URING && event.data.fd == m_uring.getFd())
 	    {
-		std::cerr << "idle::epoll_ctl failed: " << strerror(errno) <<std::endl;
 		continue;
 	    }
-	    if(real_events & READ)
+	    if(event.data.fd == m_timerFd)
 	    {
-		fd_ctx->triggerEvent(READ);
-		--m_pendingEventCount;
+		drainTimerFd();
+		timer_fired = true;
+		continue;
 	    }
-	    if(real_events & WRITE)
+	    dispatchFdEvent(event,me->epfd,&local);
+	}
+	if(m_ioBackend == IO_URING)
+	{
+	    uringReap(batch);
+	}
+	listExpiredFunc(batch.funcs);
+	expireEventDeadlines(batch);
+	if(timer_fired)
+	{
+	    // 本线程接下来去执行任务，先为下一个定时器设置好timerfd，其他空闲线程会被它唤醒
+	    auto deadline = nextDeadline();
+	    if(deadline != std::chrono::steady_clock::time_point::max())
 	    {
-		fd_ctx->triggerEvent(WRITE);
-		--m_pendingEventCount;
+		armTimerFd(deadline);
 	    }
 	}
+	schedulerBatch(std::make_move_iterator(batch.funcs.begin()),std::make_move_iterator(batch.funcs.end()));
+	schedulerBatch(std::make_move_iterator(batch.coroutines.begin()),std::make_move_iterator(batch.coroutines.end()));
+	schedulerBatch(std::make_move_iterator(local.funcs.begin()),std::make_move_iterator(local.funcs.end()),local.thread);
+	schedulerBatch(std::make_move_iterator(local.coroutines.begin()),std::make_move_iterator(local.coroutines.end()),local.thread);
 	Coroutine::getCoroutine()->yield();
     }
 }
 
+void IOManager::collectMetrics(MetricsSnapshot& snapshot, const std::string& labels)
+{
+    typedef MetricsSnapshot M;
+    Scheduler::collectMetrics(snapshot,labels);
+    snapshot.add("hourglass_pending_events","Fd events and io_uring operations being waited on.",M::GAUGE,m_pendingEventCount.load(),labels);
+    snapshot.add("hourglass_event_deadlines","Fd waits with a deadline.",M::GAUGE,m_eventDeadlineCount.load(),labels);
+    snapshot.add("hourglass_epoll_ctl_total","epoll_ctl calls for fds.",M::COUNTER,getEpollCtlCalls(),labels);
+    snapshot.add("hourglass_wakeup_syscalls_total","eventfd writes and reads used to wake workers.",M::COUNTER,getWakeupSyscalls(),labels);
+    snapshot.add("hourglass_coalesced_wakeups_total","Wakeups skipped because no worker needed one.",M::COUNTER,getCoalescedWakeups(),labels);
+    snapshot.add("hourglass_reactor_handoffs_total","Waits resumed on another worker's reactor.",M::COUNTER,getReactorHandoffs(),labels);
+    for(size_t i = 0;i < m_parkers.size();i++)
+    {
+	std::string worker_labels = M::join(labels,M::label("worker",(int64_t)i));
+	Parker::Stats& stats = m_parkers[i]->stats;
+	snapshot.add("hourglass_worker_epoll_waits_total","epoll_wait returns.",M::COUNTER,stats.epollWaits.get(),worker_labels);
+	snapshot.add("hourglass_worker_epoll_events_total","Events returned by epoll_wait.",M::COUNTER,stats.epollEvents.get(),worker_labels);
+    }
+    collectTimerMetrics(snapshot,labels);
+}
+
 void IOManager::onTimerInsertAtFront()
 {
-    tickle();
+    if(m_reactorMode != SHARED_REACTOR)
+    {
+	// 各线程阻塞在自己的epoll上，timerfd注册在所有epoll上，直接重新设置即可，不需要唤醒
+	auto deadline = nextDeadline();
+	if(deadline != std::chrono::steady_clock::time_point::max())
+	{
+	    armTimerFd(deadline);
+	}
+	return;
+    }
+    // 新的最早定时器需要poller重新计算epoll_wait的超时；没有poller时唤醒一个follower来接替
+    int follower = -1;
+    for(size_t i = 0;i < m_parkers.size();i++)
+    {
+	int state = m_parkers[i]->state;
+	if(state == POLLER && wakeWorker(i))
+	{
+	    return;
+	}
+	if(state == FOLLOWER && follower == -1)
+	{
+	    follower = i;
+	}
+    }
+    if(follower != -1)
+    {
+	wakeWorker(follower);
+    }
 }
 }
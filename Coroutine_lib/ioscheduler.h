@@ -9,6 +9,11 @@
 #define _IOSCHEDULER_H_
 #include "scheduler.h"
 #include "timer.h"
+#include "uring.h"
+#include "fdtable.h"
+#include "spinlock.h"
+#include <sys/socket.h>
+#include <sys/epoll.h>
 
 namespace Hourglass
 {
@@ -23,20 +28,89 @@ public:
 	WRITE = 0x4
     };
 
-    IOManager(size_t threads = 1, bool use_caller = true,const std::string& name = "IOManager");
+    // IO后端：EPOLL为就绪通知；IO_URING为完成通知，内核不支持时自动退回EPOLL
+    enum IOBackend
+    {
+	EPOLL = 0,
+	IO_URING = 1
+    };
+
+    // 带截止时间的waitEvent的结果
+    enum EventResult
+    {
+	EVENT_READY = 0,
+	EVENT_TIMEOUT = 1
+    };
+
+    // reactor模式：SHARED_REACTOR为所有线程共用一个epoll；另外两种每个工作线程各有一个epoll，
+    // fd在第一次addEvent时分配给某个reactor（THREAD_REACTOR取注册它的线程，不在工作线程上时按fd散列；
+    // HASH_REACTOR按fd散列），之后等待它的协程都在该reactor所在的线程上恢复．
+    // use_caller时主线程不参与分配（它的epoll只在stop()中才被等待），在主线程上注册的fd也按散列
+    enum ReactorMode
+    {
+	SHARED_REACTOR = 0,
+	THREAD_REACTOR = 1,
+	HASH_REACTOR = 2
+    };
+
+    // timer_backend选择定时器的存储方式，大量频繁刷新的超时定时器建议使用TimerManager::WHEEL
+    IOManager(size_t threads = 1, bool use_caller = true,const std::string& name = "IOManager",TimerManager::Backend timer_backend = TimerManager::SET,IOBackend io_backend = EPOLL,ReactorMode reactor_mode = SHARED_REACTOR);
     ~IOManager();
+    // 成功返回0，失败返回-1．持久注册的fd上事件已经就绪时不会等待：带回调时直接调度回调，
+    // 不带回调时返回1，调用者不要挂起，直接重试IO
     int addEvent(int fd,Event event,std::function<void()> func = nullptr);
+    // 在协程中等待fd上的事件：挂起当前协程直到事件就绪（或被cancel）或者到达deadline，
+    // 返回EVENT_READY或EVENT_TIMEOUT，注册失败返回-1．截止时间记在fd的事件上下文里，不创建Timer；
+    // 就绪与超时在fd的锁下决定谁先生效，协程只会被恢复一次
+    int waitEvent(int fd,Event event,std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
     bool delEvent(int fd,Event event);
     bool cancelEvent(int fd,Event event);  
     bool cancelAll(int fd);
     static IOManager* GetIOManager();
+    //实际使用的IO后端
+    IOBackend getIOBackend() const {return m_ioBackend;}
+    ReactorMode getReactorMode() const {return m_reactorMode;}
+    // 显式地把fd交给下标为index（小于创建的线程数）的工作线程的reactor，fd上还有等待的事件时返回false
+    // 分配一直有效，直到cancelAll（hook中的close会调用）
+    bool setFdReactor(int fd, int index);
+    // 持久注册：之后第一次addEvent的fd以EPOLLET同时注册读写并一直留在epoll中，就绪的边沿记在FdContext里，
+    // 等待和分发事件都不再调用epoll_ctl．这样的fd在关闭前必须调用cancelAll（hook中的close会调用），
+    // 否则复用同一个fd号的新文件收不到事件
+    void setPersistentEvents(bool enable) {m_persistentEvents = enable;}
+    // 在本IOManager的所有工作线程上开启系统调用hook（见hook.h），协程在工作线程之间迁移后hook仍然有效
+    void setHookEnable(bool enable) {m_hookEnable = enable;}
+    bool isHookEnable() const {return m_hookEnable.load(std::memory_order_relaxed);}
+    // 对fd调用epoll_ctl的次数
+    uint64_t getEpollCtlCalls() const {return m_epollCtlCalls.load(std::memory_order_relaxed);}
+    // 在一个线程上等待、却要到另一个reactor所在的线程上恢复的次数
+    uint64_t getReactorHandoffs() const {return m_reactorHandoffs.load(std::memory_order_relaxed);}
+
+    // 完成式IO：在本调度器的协程中调用时挂起协程直到操作完成，返回值和errno与对应的系统调用一致
+    // IO_URING后端把操作提交给内核，同一轮循环中的提交合并为一次io_uring_enter；
+    // EPOLL后端在fd就绪后执行系统调用（fd需要是非阻塞的）．不在协程中调用时直接执行系统调用．
+    // 操作进行期间缓冲区必须有效，且不能位于共享栈上
+    ssize_t asyncRead(int fd, void* buf, size_t count, off_t offset = -1);
+    ssize_t asyncWrite(int fd, const void* buf, size_t count, off_t offset = -1);
+    int asyncAccept(int fd, sockaddr* addr, socklen_t* addrlen, int flags = 0);
+    int asyncConnect(int fd, const sockaddr* addr, socklen_t addrlen);
+    // 挂起当前协程timeout时间，返回0
+    int asyncTimeout(std::chrono::nanoseconds timeout);
+    //唤醒相关的系统调用次数（写eventfd和清空eventfd）
+    uint64_t getWakeupSyscalls() const {return m_wakeupSyscalls.load(std::memory_order_relaxed);}
+    //因为没有可唤醒的线程或目标已被唤醒而省掉的唤醒次数
+    uint64_t getCoalescedWakeups() const {return m_coalescedWakeups.load(std::memory_order_relaxed);}
+    //平均每个执行的任务花费的唤醒系统调用数
+    double getWakeupSyscallsPerTask() const;
 
 protected:
     void tickle() override;
+    void tickleThread(int thread) override;
     bool stopping() override;
     void idle() override;
+    // 协程排队的SQE在它让出之后立即提交，工作线程一直忙时也不会积压
+    void afterTask() override {uringFlush();}
     void onTimerInsertAtFront() override;
-    void contextResize(size_t size);
+    void collectMetrics(MetricsSnapshot& snapshot, const std::string& labels) override;
 
 private: 
     struct FdContext
@@ -46,22 +120,165 @@ private:
 	    Scheduler *scheduler = nullptr;
 	    std::shared_ptr<Coroutine> coroutine;
 	    std::function<void()> func;
+	    // 带截止时间的等待在m_eventDeadlines中的下标，-1表示没有，只在持有m_eventDeadlineMutex时修改
+	    std::atomic<int> deadlineIndex = {-1};
+	    // 每次addEvent加一，超时时用来确认还是同一次等待
+	    uint32_t seq = 0;
 	};
-	EventContext read;
-	EventContext write;
+	// 紧凑布局：fd、事件和一字节的锁都在前16字节中．EventContext在libstdc++下是64字节，
+	// 但只按8字节对齐，不保证落在同一个缓存行里
 	int fd = 0;
 	Event events = NONE;
-	std::mutex mutex;
+	SpinLock mutex;
+	// 持久注册：是否一直留在epoll中，以及边沿到达时没有人等待而记下的就绪事件
+	bool registered = false;
+	uint8_t ready = NONE;
+	// 所属reactor的下标，-1表示还没有分配（SHARED_REACTOR模式下不使用）
+	int reactor = -1;
+	EventContext read;
+	EventContext write;
+
+	explicit FdContext(size_t index):fd((int)index){}
+	// idle中批量分发就绪事件时先收集起来，最后一次性提交给调度器
+	struct TriggerBatch
+	{
+	    Scheduler* scheduler = nullptr;
+	    // 任务指定运行的线程，-1表示任意线程
+	    int thread = -1;
+	    std::vector<std::function<void()>> funcs;
+	    std::vector<std::shared_ptr<Coroutine>> coroutines;
+	};
 	EventContext& getEventContext(Event event);
 	void resetEventContext(EventContext & ectx);
-	void triggerEvent(Event event);
+	// batch不为空且事件属于同一个调度器时放入batch，否则直接提交
+	void triggerEvent(Event event, TriggerBatch* batch = nullptr);
     };
        
-    int m_epfd = 0;
-    int m_tickleFds[2];
+    // 空闲线程的等待方式：同一时刻只有一个线程（poller）阻塞在epoll_wait上，
+    // 其余空闲线程（follower）各自阻塞在自己的eventfd上，这样可以精确唤醒某个线程．
+    // 唤醒者先把状态CAS成RUNNING再写eventfd，同一个线程在醒来前只会被写一次
+    enum ParkState
+    {
+	RUNNING = 0,
+	FOLLOWER = 1,
+	POLLER = 2
+    };
+    // 每线程reactor模式下没有follower，空闲线程都以POLLER状态阻塞在自己的epoll上，wakeFd也注册在其中
+    struct Parker
+    {
+	int wakeFd = -1;
+	// 每线程reactor模式下本线程的epoll
+	int epfd = -1;
+	std::atomic<int> state = {RUNNING};
+	// 只有本线程写的计数器：epoll_wait返回的次数和返回的事件总数
+	struct alignas(64) Stats
+	{
+	    LocalCounter epollWaits;
+	    LocalCounter epollEvents;
+	} stats;
+    };
+    // 唤醒下标为index的工作线程，返回是否真的写了eventfd
+    bool wakeWorker(size_t index);
+    // 清空eventfd，被唤醒者调用
+    void drainWakeFd(int fd);
+    // 以fd_ctx为data调用epoll_ctl并计数
+    int epollCtl(int epfd, int op, FdContext* fd_ctx, uint32_t events);
+    // fd所在的epoll
+    int epollFd(FdContext* fd_ctx) const {return m_reactorMode == SHARED_REACTOR ? m_epfd : m_parkers[fd_ctx->reactor]->epfd;}
+    // 分发epfd上一个fd的就绪事件，触发的回调和协程放入batch
+    void dispatchFdEvent(epoll_event& event, int epfd, FdContext::TriggerBatch* batch);
+    // 每线程reactor模式下的idle：阻塞在自己的epoll上，就绪的fd在本线程上恢复
+    void reactorIdle();
+    // 为第一次注册的fd选择reactor
+    int pickReactor(int fd) const;
+
+    // 一个正在进行的io_uring操作，user_data指向它．挂起期间内核和取完成事件的线程都会访问它，
+    // 共享栈的协程挂起时栈会被换出，所以不能放在协程栈上，而是从每线程的空闲链表分配
+    struct UringRequest
+    {
+	std::shared_ptr<Coroutine> coroutine;
+	int result = 0;
+	__kernel_timespec timeout;
+
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+    };
+    // 提交一个操作并挂起当前协程，返回内核给出的结果（失败时为-errno）
+    int uringCall(UringRequest* req, uint8_t opcode, int fd, uint64_t addr, uint32_t len, uint64_t off, uint32_t flags, uint64_t addr2 = 0);
+    // 把已经排队的SQE一次性提交
+    void uringFlush();
+    // 取出完成队列中的结果，同一时刻只有一个线程在取，抢不到时直接返回
+    void uringReap(FdContext::TriggerBatch& batch);
+    // addEvent的实现：deadline为截止时间（纳秒，0表示不超时），超时时把EVENT_TIMEOUT写入*result，
+    // 新的截止时间成为最早的一个时把*at_front设为true
+    int addEvent(int fd, Event event, std::function<void()> func, int64_t deadline, int* result, bool* at_front);
+    // 取消fd_ctx上正在等待的event并触发它，调用前需要持有fd_ctx->mutex
+    bool cancelEventLocked(FdContext* fd_ctx, Event event, FdContext::TriggerBatch* batch = nullptr);
+    // 事件触发或取消时移除它的截止时间，之后调用triggerEvent
+    void finishEvent(FdContext* fd_ctx, Event event, FdContext::TriggerBatch* batch = nullptr);
+
+    // 带截止时间的事件等待，按deadline排列的最小堆，元素的下标记在对应的EventContext中，
+    // 事件先触发时直接从堆中删除
+    struct EventDeadline
+    {
+	int64_t deadline;
+	FdContext* fdCtx;
+	Event event;
+	uint32_t seq;
+	int* result;
+    };
+    std::vector<EventDeadline> m_eventDeadlines;
+    SpinLock m_eventDeadlineMutex;
+    std::atomic<size_t> m_eventDeadlineCount = {0};
+    // 以下三个函数调用前需要持有m_eventDeadlineMutex
+    void deadlinePlace(size_t index, const EventDeadline& entry);
+    void deadlineSiftUp(size_t index);
+    void deadlineSiftDown(size_t index);
+    // 放入堆，返回是否成为最早的一个
+    bool pushEventDeadline(const EventDeadline& entry);
+    void removeEventDeadline(FdContext::EventContext& ctx);
+    // 超时的等待取消掉，被唤醒的协程放入batch
+    void expireEventDeadlines(FdContext::TriggerBatch& batch);
+    // 定时器和事件截止时间中最早的一个
+    std::chrono::steady_clock::time_point nextDeadline();
+
+    IOBackend m_ioBackend = EPOLL;
+    IoUring m_uring;
+    // 保护SQ
+    std::mutex m_uringMutex;
+    // 完成队列只能有一个消费者
+    SpinLock m_uringReapMutex;
+    // 已排队还没提交的SQE个数，为0时不用加锁
+    std::atomic<unsigned> m_uringQueued = {0};
+
+    ReactorMode m_reactorMode = SHARED_REACTOR;
+    // SHARED_REACTOR模式下共用的epoll
+    int m_epfd = -1;
+    // 注册在epoll上的eventfd，用来唤醒poller
+    int m_tickleFd = -1;
+    // 注册在epoll上的timerfd（CLOCK_MONOTONIC），按纳秒精度在最近的定时器到期时唤醒poller
+    int m_timerFd = -1;
+    // timerfd当前设置的到期时间，相同时不用重复设置
+    std::chrono::steady_clock::time_point m_timerFdDeadline;
+    // 保护timerfd的设置，每线程reactor模式下任何线程都可能设置
+    SpinLock m_timerFdMutex;
+    void armTimerFd(std::chrono::steady_clock::time_point deadline);
+    // 读掉timerfd的到期次数，下次需要重新设置
+    void drainTimerFd();
+    // 是否已经有线程在epoll_wait
+    std::atomic<bool> m_polling = {false};
+    std::vector<std::unique_ptr<Parker>> m_parkers;
+    std::atomic<uint64_t> m_wakeupSyscalls = {0};
+    std::atomic<uint64_t> m_coalescedWakeups = {0};
+    std::atomic<uint64_t> m_reactorHandoffs = {0};
+    std::atomic<uint64_t> m_epollCtlCalls = {0};
+    std::atomic<bool> m_persistentEvents = {false};
+    std::atomic<bool> m_hookEnable = {false};
     std::atomic<size_t> m_pendingEventCount = {0};
-    std::shared_mutex m_mutex;
-    std::vector<FdContext*> m_fdcontext;
+    // fd上下文按fd分页存放，读取不加锁
+    PagedTable<FdContext> m_fdcontext;
+    // 取fd的上下文，create为false且不存在时返回nullptr
+    FdContext* getFdContext(int fd, bool create);
 };
 }
 #endif
@@ -0,0 +1,143 @@
+/*
+ - File Name: metrics.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sat 31 Oct 2026 10:41:19 AM CST
+ */
+
+#include "metrics.h"
+#include <cstdio>
+#include <cinttypes>
+#include <unistd.h>
+
+namespace Hourglass
+{
+void MetricsSnapshot::add(const std::string& name, const std::string& help, Type type, double value, const std::string& labels)
+{
+    for(Metric& metric : m_metrics)
+    {
+	if(metric.name == name)
+	{
+	    metric.values.emplace_back(labels,value);
+	    return;
+	}
+    }
+    m_metrics.push_back({name,help,type,{{labels,value}}});
+}
+
+double MetricsSnapshot::get(const std::string& name, const std::string& labels) const
+{
+    for(const Metric& metric : m_metrics)
+    {
+	if(metric.name != name)
+	{
+	    continue;
+	}
+	for(auto& value : metric.values)
+	{
+	    if(value.first == labels)
+	    {
+		return value.second;
+	    }
+	}
+    }
+    return -1;
+}
+
+double MetricsSnapshot::sum(const std::string& name) const
+{
+    double total = 0;
+    for(const Metric& metric : m_metrics)
+    {
+	if(metric.name == name)
+	{
+	    for(auto& value : metric.values)
+	    {
+		total += value.second;
+	    }
+	}
+    }
+    return total;
+}
+
+std::string MetricsSnapshot::toPrometheus() const
+{
+    std::string out;
+    char buf[64];
+    for(const Metric& metric : m_metrics)
+    {
+	out += "# HELP " + metric.name + " " + metric.help + "\n";
+	out += "# TYPE " + metric.name + (metric.type == COUNTER ? " counter\n" : " gauge\n");
+	for(auto& value : metric.values)
+	{
+	    out += metric.name;
+	    if(!value.first.empty())
+	    {
+		out += "{" + value.first + "}";
+	    }
+	    // 整数值按整数输出，避免计数器出现科学计数法
+	    if(value.second == (double)(int64_t)value.second)
+	    {
+		snprintf(buf,sizeof(buf)," %" PRId64 "\n",(int64_t)value.second);
+	    }
+	    else
+	    {
+		snprintf(buf,sizeof(buf)," %.9g\n",value.second);
+	    }
+	    out += buf;
+	}
+    }
+    return out;
+}
+
+bool writeFileAtomic(const std::string& path, const std::string& text)
+{
+    std::string tmp = path + ".tmp";
+    FILE* file = fopen(tmp.c_str(),"w");
+    if(!file)
+    {
+	return false;
+    }
+    bool ok = fwrite(text.data(),1,text.size(),file) == text.size();
+    // 内容落盘之后再rename，掉电后不会留下一个空的新文件
+    ok = fflush(file) == 0 && fsync(fileno(file)) == 0 && ok;
+    ok = fclose(file) == 0 && ok;
+    if(!ok || rename(tmp.c_str(),path.c_str()))
+    {
+	remove(tmp.c_str());
+	return false;
+    }
+    return true;
+}
+
+std::string MetricsSnapshot::label(const std::string& key, const std::string& value)
+{
+    std::string out = key + "=\"";
+    for(char c : value)
+    {
+	if(c == '\\' || c == '"')
+	{
+	    out += '\\';
+	    out += c;
+	}
+	else if(c == '\n')
+	{
+	    out += "\\n";
+	}
+	else
+	{
+	    out += c;
+	}
+    }
+    return out + "\"";
+}
+
+std::string MetricsSnapshot::join(const std::string& lhs, const std::string& rhs)
+{
+    if(lhs.empty())
+    {
+	return rhs;
+    }
+    return rhs.empty() ? lhs : lhs + "," + rhs;
+}
+}
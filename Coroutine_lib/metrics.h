@@ -0,0 +1,75 @@
+/*
+ - File Name: metrics.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sat 31 Oct 2026 10:05:44 AM CST
+ */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Hourglass
+{
+// 把text原子地写到path：先写临时文件并fsync，再rename覆盖，读的一方不会看到写了一半的文件．
+// 指标和trace的导出都用它
+bool writeFileAtomic(const std::string& path, const std::string& text);
+
+// 只有一个线程写的计数器：用load+store代替带lock前缀的原子加，其他线程随时可以读到某个最近的值．
+// 每个工作线程各用一组，读取时汇总
+class LocalCounter
+{
+private:
+    std::atomic<uint64_t> m_value = {0};
+
+public:
+    void add(uint64_t n = 1) {m_value.store(m_value.load(std::memory_order_relaxed) + n,std::memory_order_relaxed);}
+    uint64_t get() const {return m_value.load(std::memory_order_relaxed);}
+};
+
+// 一次采集到的指标，可以按名字取值，也可以输出成Prometheus的文本格式
+class MetricsSnapshot
+{
+public:
+    enum Type
+    {
+	COUNTER = 0,
+	GAUGE = 1
+    };
+
+    struct Metric
+    {
+	std::string name;
+	std::string help;
+	Type type;
+	// 每个值的标签（已经格式化成 key="value",... ）与数值
+	std::vector<std::pair<std::string,double>> values;
+    };
+
+private:
+    std::vector<Metric> m_metrics;
+
+public:
+    // 同名的指标合并在一起，labels为空表示没有标签
+    void add(const std::string& name, const std::string& help, Type type, double value, const std::string& labels = "");
+    const std::vector<Metric>& getMetrics() const {return m_metrics;}
+    // 名字和标签都相同的值，不存在时返回-1
+    double get(const std::string& name, const std::string& labels = "") const;
+    // 同名指标所有值的和，不存在时返回0
+    double sum(const std::string& name) const;
+    // Prometheus文本格式（exposition format 0.0.4）
+    std::string toPrometheus() const;
+    // 用writeFileAtomic写入，读的一方（如node_exporter的textfile collector）不会看到写了一半的文件
+    bool writeFile(const std::string& path) const {return writeFileAtomic(path,toPrometheus());}
+
+    // 拼接标签：label("worker", 0) -> worker="0"
+    static std::string label(const std::string& key, const std::string& value);
+    static std::string label(const std::string& key, int64_t value) {return label(key,std::to_string(value));}
+    static std::string join(const std::string& lhs, const std::string& rhs);
+};
+}
+#endif
@@ -6,9 +6,138 @@
  */
 
 #include "scheduler.h"
+#include "stack.h"
+#include "trace.h"
+#include <algorithm>
 namespace Hourglass
 {
 static thread_local Scheduler* t_scheduler = nullptr;
+thread_local Scheduler::Worker* Scheduler::t_worker = nullptr;
+
+static inline int64_t monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// SchedulerTask的空闲链表：每个线程缓存最多2*TASK_BATCH个，多了整批交给全局池，
+// 缓存空了先从全局池取一批．外部线程提交、工作线程执行时，任务对象就这样整批流转．
+// 全局池最多保留TASK_POOL_BATCHES批（64K个任务对象），一次积压过的峰值之后多出来的整批直接释放
+static const size_t TASK_BATCH = 64;
+static const size_t TASK_POOL_BATCHES = 1024;
+
+struct TaskNode
+{
+    TaskNode* next;
+};
+
+static void freeTaskNodes(TaskNode* node)
+{
+    while(node)
+    {
+	TaskNode* next = node->next;
+	::operator delete(node);
+	node = next;
+    }
+}
+
+struct TaskPool
+{
+    std::mutex mutex;
+    std::vector<std::pair<TaskNode*,size_t>> batches;
+
+    // 全局池已满时释放这一批
+    void put(TaskNode* head, size_t count)
+    {
+	{
+	    std::lock_guard<std::mutex> lock(mutex);
+	    if(batches.size() < TASK_POOL_BATCHES)
+	    {
+		batches.emplace_back(head,count);
+		return;
+	    }
+	}
+	freeTaskNodes(head);
+    }
+
+    ~TaskPool()
+    {
+	for(auto& batch : batches)
+	{
+	    freeTaskNodes(batch.first);
+	}
+    }
+};
+
+static TaskPool s_taskPool;
+
+struct TaskCache
+{
+    TaskNode* head = nullptr;
+    size_t count = 0;
+
+    ~TaskCache()
+    {
+	if(head)
+	{
+	    s_taskPool.put(head,count);
+	    head = nullptr;
+	    count = 0;
+	}
+    }
+};
+
+static thread_local TaskCache t_taskCache;
+
+void* Scheduler::SchedulerTask::operator new(size_t size)
+{
+    assert(size == sizeof(SchedulerTask));
+    TaskCache& cache = t_taskCache;
+    if(!cache.head)
+    {
+	std::lock_guard<std::mutex> lock(s_taskPool.mutex);
+	if(!s_taskPool.batches.empty())
+	{
+	    cache.head = s_taskPool.batches.back().first;
+	    cache.count = s_taskPool.batches.back().second;
+	    s_taskPool.batches.pop_back();
+	}
+    }
+    if(!cache.head)
+    {
+	return ::operator new(std::max(size,sizeof(TaskNode)));
+    }
+    TaskNode* node = cache.head;
+    cache.head = node->next;
+    cache.count--;
+    return node;
+}
+
+void Scheduler::SchedulerTask::operator delete(void* ptr)
+{
+    if(!ptr)
+    {
+	return;
+    }
+    TaskCache& cache = t_taskCache;
+    TaskNode* node = static_cast<TaskNode*>(ptr);
+    node->next = cache.head;
+    cache.head = node;
+    cache.count++;
+    if(cache.count >= 2 * TASK_BATCH)
+    {
+	// 摘下前TASK_BATCH个交给全局池
+	TaskNode* tail = cache.head;
+	for(size_t i = 1;i < TASK_BATCH;i++)
+	{
+	    tail = tail->next;
+	}
+	TaskNode* batch = cache.head;
+	cache.head = tail->next;
+	cache.count -= TASK_BATCH;
+	tail->next = nullptr;
+	s_taskPool.put(batch,TASK_BATCH);
+    }
+}
 
 Scheduler* Scheduler::GetThis()
 {
@@ -30,11 +159,21 @@ Scheduler::Scheduler(size_t threads,bool use_caller,const std::string& name):s_u
 	threads--;
 	Coroutine::getCoroutine();
 	s_schedulerCoroutine.reset(new Coroutine(std::bind(&Scheduler::run,this),0,false));
+	s_schedulerCoroutine->setStackTag("Scheduler::run");
 	Coroutine::setSchedulerCortinue(s_schedulerCoroutine.get());
 	s_rootThread = Thread::GetThreadID();
 	s_threadIDs.push_back(s_rootThread);
     }
     s_threadCount = threads;
+    for(size_t i = 0;i < s_threadCount + (use_caller ? 1 : 0);i++)
+    {
+	s_workers.emplace_back(new Worker());
+	s_workers.back()->index = i;
+    }
+    if(use_caller)
+    {
+	s_workers.back()->threadID = s_rootThread;
+    }
 }
 
 Scheduler::~Scheduler()
@@ -44,6 +183,31 @@ Scheduler::~Scheduler()
     {
 	t_scheduler = nullptr;
     }
+    while(!s_tasks.empty())
+    {
+	delete s_tasks.front();
+	s_tasks.pop_front();
+    }
+    for(auto& worker : s_workers)
+    {
+	SchedulerTask* task = nullptr;
+	while(worker->queue.steal(task))
+	{
+	    delete task;
+	}
+	while(!worker->mailbox.empty())
+	{
+	    delete worker->mailbox.front();
+	    worker->mailbox.pop_front();
+	}
+    }
+    for(auto& tasks : s_priorityTasks)
+    {
+	for(SchedulerTask* task : tasks)
+	{
+	    delete task;
+	}
+    }
 }
 
 void Scheduler::start()
@@ -58,7 +222,14 @@ void Scheduler::start()
     s_threads.resize(s_threadCount);
     for(size_t i = 0;i < s_threadCount;i++)
     {
-	s_threads[i].reset(new Thread(std::bind(&Scheduler::run,this),s_name + "_" + std::to_string(i)));
+	Worker* worker = s_workers[i].get();
+	s_threads[i].reset(new Thread([this,worker]()
+	{
+	    t_worker = worker;
+	    run();
+	},s_name + "_" + std::to_string(i)));
+	// start返回之后就可以向这些线程提交指定线程的任务
+	worker->threadID = s_threads[i]->getID();
 	s_threadIDs.push_back(s_threads[i]->getID());
     }
 }
@@ -72,33 +243,33 @@ void Scheduler::run()
 	Coroutine::getCoroutine();
     }
     std::shared_ptr<Coroutine> idle_Coroutine = std::make_shared<Coroutine>(std::bind(&Scheduler::idle,this));
+    idle_Coroutine->setStackTag("Scheduler::idle");
+    // 创建的线程在start中已经绑定了Worker
+    Worker* self = thread_id == s_rootThread ? s_workers.back().get() : t_worker;
+    self->threadID = thread_id;
+    t_worker = self;
     SchedulerTask task;
+    CoroutinePool pool;
+    uint64_t tick = 0;
     while(true)
     {
 	task.reset();
-	bool tickle_me = false;
+	SchedulerTask* next = dequeue(self,++tick);
+	if(next)
 	{
-	    std::lock_guard<std::mutex> lock(s_mutex);
-	    auto it = s_tasks.begin();
-	    while(it != s_tasks.end())
+	    assert(next->coroutine || next->func);
+	    task = std::move(*next);
+	    delete next;
+	    self->stats.tasks.add();
+	    if(task.enqueueTime && s_queueDelayStats.load(std::memory_order_relaxed))
 	    {
-		if(it->thread != -1 && it->thread != thread_id)
-		{
-		    it++;
-		    tickle_me = true;
-		    continue;
-		}
-		assert(it->coroutine || it->func);
-		task = *it;
-		s_tasks.erase(it);
-		s_activateThreadCount++;
-		break;
+		s_queueDelay[task.priority].record(std::max<int64_t>(monotonicNs() - task.enqueueTime,0));
+	    }
+	    // 还有其他线程可以执行的任务，唤醒其他线程来窃取
+	    if(hasSharedTask())
+	    {
+		tickle();
 	    }
-	    tickle_me = tickle_me || (it != s_tasks.end());
-	}
-	if(tickle_me)
-	{
-	    tickle();
 	}
 
 	if(task.coroutine)
@@ -107,21 +278,34 @@ void Scheduler::run()
 		std::lock_guard<std::mutex> lock(task.coroutine->c_mutex);
 		if(task.coroutine->getState() != Coroutine::TERM)
 		{
+		    task.coroutine->setPriority(task.priority,task.deadline);
+		    self->stats.switches.add();
 		    task.coroutine->resume();
 		}
 	    }
+	    afterTask();
 	    s_activateThreadCount--;
+	    releaseNormalSlot(self);
+	    recycleCoroutine(pool,task.coroutine);
 	    task.reset();
+	    tickleAllIfStopped();
 	}
 	else if(task.func)
 	{
-	    std::shared_ptr<Coroutine> func_cor = std::make_shared<Coroutine>(task.func);
+	    std::shared_ptr<Coroutine> func_cor = acquireCoroutine(pool,task.func,task.stackSize);
+	    func_cor->setPriority(task.priority,task.deadline);
+	    func_cor->setStackSite(task.site);
 	    {
 		std::lock_guard<std::mutex> lock(func_cor->c_mutex);
+		self->stats.switches.add();
 		func_cor->resume();
 	    }
+	    afterTask();
 	    s_activateThreadCount--;
+	    releaseNormalSlot(self);
+	    recycleCoroutine(pool,func_cor);
 	    task.reset();
+	    tickleAllIfStopped();
 	}
 	else
 	{
@@ -130,10 +314,454 @@ void Scheduler::run()
 		break;
 	    }
 	    s_idleThreadCount++;
+	    // 与enqueue配对：要么提交者看到空闲线程而tickle，要么这里看到新任务
+	    if(hasPendingTask())
+	    {
+		s_idleThreadCount--;
+		continue;
+	    }
+	    self->stats.idles.add();
+	    self->stats.switches.add();
+	    int64_t idle_start = monotonicNs();
 	    idle_Coroutine->resume();
+	    self->stats.idleNs.add(monotonicNs() - idle_start);
 	    s_idleThreadCount--;
 	}
     }
+    t_worker = nullptr;
+}
+
+Scheduler::Worker* Scheduler::getWorker(int thread_id) const
+{
+    for(auto& worker : s_workers)
+    {
+	if(worker->threadID == thread_id)
+	{
+	    return worker.get();
+	}
+    }
+    return nullptr;
+}
+
+int Scheduler::enqueue(SchedulerTask* task)
+{
+    Worker* self = GetThis() == this ? t_worker : nullptr;
+    if(s_queueDelayStats.load(std::memory_order_relaxed))
+    {
+	task->enqueueTime = monotonicNs();
+    }
+    if(Tracer::isEnabled())
+    {
+	Tracer::record(Tracer::SPAWN,task->coroutine ? task->coroutine->getID() : (uint64_t)-1,Coroutine::getCorID());
+    }
+    if(task->thread != -1)
+    {
+	Worker* target = getWorker(task->thread);
+	if(target)
+	{
+	    s_pinnedCount++;
+	    s_taskCount++;
+	    {
+		std::lock_guard<std::mutex> lock(target->mailboxMutex);
+		target->mailbox.push_back(task);
+		target->mailboxCount++;
+	    }
+	    // 只需要唤醒目标线程；目标就是自己时它正在运行，不用唤醒
+	    return target == self ? -2 : task->thread;
+	}
+	std::cerr << "Scheduler::schedulerLock thread " << task->thread << " is not a worker of " << s_name << std::endl;
+	task->thread = -1;
+    }
+    if(task->isPrioritized())
+    {
+	enqueuePriority(task);
+	// 与普通任务不同，不管队列原来是否为空都请求唤醒：队列中已经有普通任务时，保留的线程也可能正停在idle中．
+	// 调度是协作式的，所有线程都在执行任务时tickle什么也不做，任务等到某个线程的任务让出或结束，
+	// 那时dequeue先取信箱再取HIGH，时延上限是各线程当前任务到下一次让出的最短时间
+	return -1;
+    }
+    // 先计数再入队，保证stopping()不会在任务可见之前认为已经没有任务
+    bool need_tickle = s_taskCount.fetch_add(1) == s_pinnedCount;
+    if(self)
+    {
+	self->queue.push(task);
+    }
+    else
+    {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_tasks.push_back(task);
+	s_globalCount++;
+    }
+    return need_tickle ? -1 : -2;
+}
+
+size_t Scheduler::enqueueBatch(std::vector<SchedulerTask*>& tasks)
+{
+    size_t n = 0;
+    int64_t now = s_queueDelayStats.load(std::memory_order_relaxed) ? monotonicNs() : 0;
+    bool trace = Tracer::isEnabled();
+    for(SchedulerTask* task : tasks)
+    {
+	task->enqueueTime = now;
+	if(task->thread != -1 || task->isPrioritized())
+	{
+	    tickleTarget(enqueue(task));
+	}
+	else
+	{
+	    if(trace)
+	    {
+		Tracer::record(Tracer::SPAWN,task->coroutine ? task->coroutine->getID() : (uint64_t)-1,Coroutine::getCorID());
+	    }
+	    tasks[n++] = task;
+	}
+    }
+    tasks.resize(n);
+    if(n == 0)
+    {
+	return 0;
+    }
+    s_taskCount += n;
+    Worker* self = GetThis() == this ? t_worker : nullptr;
+    if(self)
+    {
+	for(SchedulerTask* task : tasks)
+	{
+	    self->queue.push(task);
+	}
+    }
+    else
+    {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	for(SchedulerTask* task : tasks)
+	{
+	    s_tasks.push_back(task);
+	}
+	s_globalCount += n;
+    }
+    return n;
+}
+
+bool Scheduler::hasSharedTask() const
+{
+    if(s_taskCount <= s_pinnedCount)
+    {
+	return false;
+    }
+    size_t reserved = s_reservedWorkers.load(std::memory_order_relaxed);
+    // 非HIGH的名额已经用完时只有HIGH任务可以取
+    return reserved == 0 || s_normalRunning < s_workers.size() - reserved || s_priorityCount[HIGH] > 0;
+}
+
+bool Scheduler::hasPendingTask() const
+{
+    Worker* self = GetThis() == this ? t_worker : nullptr;
+    return hasSharedTask() || (self && self->mailboxCount > 0);
+}
+
+uint64_t Scheduler::getExecutedTasks() const
+{
+    uint64_t total = 0;
+    for(auto& worker : s_workers)
+    {
+	total += worker->stats.tasks.get();
+    }
+    return total;
+}
+
+uint64_t Scheduler::getPoolHits() const
+{
+    uint64_t total = 0;
+    for(auto& worker : s_workers)
+    {
+	total += worker->stats.poolHits.get();
+    }
+    return total;
+}
+
+uint64_t Scheduler::getPoolMisses() const
+{
+    uint64_t total = 0;
+    for(auto& worker : s_workers)
+    {
+	total += worker->stats.poolMisses.get();
+    }
+    return total;
+}
+
+MetricsSnapshot Scheduler::getMetrics()
+{
+    MetricsSnapshot snapshot;
+    collectMetrics(snapshot,MetricsSnapshot::label("scheduler",s_name));
+    return snapshot;
+}
+
+void Scheduler::collectMetrics(MetricsSnapshot& snapshot, const std::string& labels)
+{
+    typedef MetricsSnapshot M;
+    snapshot.add("hourglass_tasks_queued","Tasks waiting in any queue.",M::GAUGE,s_taskCount.load(),labels);
+    snapshot.add("hourglass_global_queue_depth","Tasks in the global injection queue.",M::GAUGE,s_globalCount.load(),labels);
+    snapshot.add("hourglass_pinned_tasks_queued","Tasks waiting in worker mailboxes.",M::GAUGE,s_pinnedCount.load(),labels);
+    static const char* priorities[PRIORITY_COUNT] = {"high","normal","low"};
+    for(int i = 0;i < PRIORITY_COUNT;i++)
+    {
+	snapshot.add("hourglass_priority_queue_depth","Tasks in the priority heap of each class.",M::GAUGE,
+	    s_priorityCount[i].load(),M::join(labels,M::label("priority",priorities[i])));
+    }
+    snapshot.add("hourglass_active_threads","Workers running a task.",M::GAUGE,s_activateThreadCount.load(),labels);
+    snapshot.add("hourglass_idle_threads","Workers in idle.",M::GAUGE,s_idleThreadCount.load(),labels);
+    for(auto& worker : s_workers)
+    {
+	std::string worker_labels = M::join(labels,M::label("worker",(int64_t)worker->index));
+	Worker::Stats& stats = worker->stats;
+	snapshot.add("hourglass_worker_tasks_total","Tasks executed by the worker.",M::COUNTER,stats.tasks.get(),worker_labels);
+	snapshot.add("hourglass_worker_context_switches_total","Switches from the scheduler coroutine to a task or idle coroutine.",M::COUNTER,stats.switches.get(),worker_labels);
+	snapshot.add("hourglass_worker_idle_total","Times the worker entered idle.",M::COUNTER,stats.idles.get(),worker_labels);
+	snapshot.add("hourglass_worker_idle_seconds_total","Time the worker spent in idle.",M::COUNTER,stats.idleNs.get() / 1e9,worker_labels);
+	snapshot.add("hourglass_worker_steals_total","Tasks stolen from other workers.",M::COUNTER,stats.steals.get(),worker_labels);
+	snapshot.add("hourglass_worker_local_queue_depth","Tasks in the worker's local deque.",M::GAUGE,worker->queue.size(),worker_labels);
+	snapshot.add("hourglass_worker_mailbox_depth","Tasks pinned to the worker.",M::GAUGE,worker->mailboxCount.load(),worker_labels);
+	snapshot.add("hourglass_coroutine_pool_hits_total","Function tasks that reused a pooled coroutine.",M::COUNTER,stats.poolHits.get(),worker_labels);
+	snapshot.add("hourglass_coroutine_pool_misses_total","Function tasks that allocated a new coroutine.",M::COUNTER,stats.poolMisses.get(),worker_labels);
+    }
+    if(s_queueDelayStats)
+    {
+	for(int i = 0;i < PRIORITY_COUNT;i++)
+	{
+	    std::string class_labels = M::join(labels,M::label("priority",priorities[i]));
+	    snapshot.add("hourglass_queue_delay_p99_seconds","99th percentile queueing delay (bucket upper bound).",M::GAUGE,
+		s_queueDelay[i].percentile(99) / 1e9,class_labels);
+	    snapshot.add("hourglass_queue_delay_samples_total","Tasks whose queueing delay was recorded.",M::COUNTER,s_queueDelay[i].getCount(),class_labels);
+	}
+    }
+}
+
+void Scheduler::setReservedWorkers(size_t count)
+{
+    size_t workers = s_workers.size();
+    s_reservedWorkers = count < workers ? count : workers - 1;
+}
+
+bool Scheduler::acquireNormalSlot(Worker* self)
+{
+    size_t reserved = s_reservedWorkers.load(std::memory_order_relaxed);
+    if(reserved == 0)
+    {
+	return true;
+    }
+    size_t limit = s_workers.size() - reserved;
+    size_t running = s_normalRunning.load();
+    while(running < limit)
+    {
+	if(s_normalRunning.compare_exchange_weak(running,running + 1))
+	{
+	    self->normalSlot = true;
+	    return true;
+	}
+    }
+    return false;
+}
+
+void Scheduler::releaseNormalSlot(Worker* self)
+{
+    if(self->normalSlot)
+    {
+	self->normalSlot = false;
+	s_normalRunning--;
+    }
+}
+
+void Scheduler::enqueuePriority(SchedulerTask* task)
+{
+    s_taskCount++;
+    std::lock_guard<std::mutex> lock(s_priorityMutex);
+    task->seq = s_prioritySeq++;
+    std::vector<SchedulerTask*>& heap = s_priorityTasks[task->priority];
+    heap.push_back(task);
+    std::push_heap(heap.begin(),heap.end(),PriorityLess());
+    s_priorityCount[task->priority]++;
+}
+
+Scheduler::SchedulerTask* Scheduler::dequeuePriority(int priority)
+{
+    if(s_priorityCount[priority] == 0)
+    {
+	return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(s_priorityMutex);
+    std::vector<SchedulerTask*>& heap = s_priorityTasks[priority];
+    if(heap.empty())
+    {
+	return nullptr;
+    }
+    std::pop_heap(heap.begin(),heap.end(),PriorityLess());
+    SchedulerTask* task = heap.back();
+    heap.pop_back();
+    s_priorityCount[priority]--;
+    return task;
+}
+
+int Scheduler::getWorkerIndex() const
+{
+    Worker* self = GetThis() == this ? t_worker : nullptr;
+    return self ? (int)self->index : -1;
+}
+
+int Scheduler::getWorkerIndex(int thread) const
+{
+    Worker* worker = getWorker(thread);
+    return worker ? (int)worker->index : -1;
+}
+
+Scheduler::SchedulerTask* Scheduler::dequeueGlobal()
+{
+    if(s_globalCount == 0)
+    {
+	return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if(s_tasks.empty())
+    {
+	return nullptr;
+    }
+    SchedulerTask* task = s_tasks.front();
+    s_tasks.pop_front();
+    s_globalCount--;
+    return task;
+}
+
+Scheduler::SchedulerTask* Scheduler::dequeueMailbox(Worker* self)
+{
+    if(self->mailboxCount == 0)
+    {
+	return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(self->mailboxMutex);
+    if(self->mailbox.empty())
+    {
+	return nullptr;
+    }
+    SchedulerTask* task = self->mailbox.front();
+    self->mailbox.pop_front();
+    self->mailboxCount--;
+    s_pinnedCount--;
+    return task;
+}
+
+Scheduler::SchedulerTask* Scheduler::dequeue(Worker* self, uint64_t tick)
+{
+    static thread_local uint32_t seed = self->threadID;
+    SchedulerTask* task = dequeueMailbox(self);
+    if(!task)
+    {
+	task = dequeuePriority(HIGH);
+    }
+    if(!task && !acquireNormalSlot(self))
+    {
+	return nullptr;
+    }
+    if(!task)
+    {
+	task = dequeuePriority(NORMAL);
+    }
+    // 本地队列一直不空时，每隔一段时间先看一次全局队列，防止全局任务饿死
+    if(!task && tick % 61 == 0)
+    {
+	task = dequeueGlobal();
+    }
+    while(!task && !self->queue.empty())
+    {
+	self->queue.steal(task);
+    }
+    if(!task)
+    {
+	task = dequeueGlobal();
+    }
+    // 从随机的一个工作线程开始依次尝试窃取
+    size_t n = s_workers.size();
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    for(size_t i = 0;!task && i < n;i++)
+    {
+	Worker* victim = s_workers[(seed + i) % n].get();
+	if(victim != self && victim->queue.steal(task))
+	{
+	    self->stats.steals.add();
+	}
+    }
+    if(!task)
+    {
+	task = dequeuePriority(LOW);
+    }
+    if(!task)
+    {
+	releaseNormalSlot(self);
+    }
+    else
+    {
+	s_activateThreadCount++;
+	s_taskCount--;
+    }
+    return task;
+}
+
+std::shared_ptr<Coroutine> Scheduler::acquireCoroutine(CoroutinePool& pool, InlineFunction& func, size_t stack_size)
+{
+    if(stack_size == Coroutine::SHARED_STACK)
+    {
+	// 共享栈协程本身没有栈，不进入池
+	return std::make_shared<Coroutine>(std::move(func),stack_size);
+    }
+    size_t size = StackAllocator::roundSize(stack_size ? stack_size : Coroutine::DEFAULT_STACK_SIZE);
+    // 从后往前找，最近回收的栈更可能还在缓存中
+    auto it = pool.coroutines.rbegin();
+    while(it != pool.coroutines.rend() && (*it)->getStackSize() != size)
+    {
+	++it;
+    }
+    if(it == pool.coroutines.rend())
+    {
+	t_worker->stats.poolMisses.add();
+	return std::make_shared<Coroutine>(std::move(func),size);
+    }
+    t_worker->stats.poolHits.add();
+    std::shared_ptr<Coroutine> cor;
+    cor.swap(*it);
+    pool.coroutines.erase(std::next(it).base());
+    pool.bytes -= cor->getStackSize();
+    cor->reset(std::move(func));
+    return cor;
+}
+
+void Scheduler::recycleCoroutine(CoroutinePool& pool, std::shared_ptr<Coroutine>& cor)
+{
+    // 仍被其他地方持有（例如注册在IOManager的事件上）的协程不能复用
+    if(!cor || cor.use_count() != 1 || cor->getState() != Coroutine::TERM)
+    {
+	return;
+    }
+    if(!cor->isRunInScheduler() || cor->getStackSize() == 0)
+    {
+	return;
+    }
+    if(pool.coroutines.size() >= s_poolMaxCount || pool.bytes + cor->getStackSize() > s_poolMaxBytes)
+    {
+	return;
+    }
+    if(s_poolReleaseStacks.load(std::memory_order_relaxed))
+    {
+	cor->releaseStack();
+    }
+    pool.bytes += cor->getStackSize();
+    pool.coroutines.push_back(std::move(cor));
+}
+
+void Scheduler::setCoroutinePool(size_t max_count, size_t max_bytes, bool release_stacks)
+{
+    s_poolMaxCount = max_count;
+    s_poolMaxBytes = max_bytes;
+    s_poolReleaseStacks = release_stacks;
 }
 
 void Scheduler::stop()
@@ -145,11 +773,10 @@ void Scheduler::stop()
     s_stopping = true;
     if(s_useCaller){assert(GetThis() == this);}
     else{assert(GetThis() != this);}
-    for(size_t i = 0;i < s_threadCount;i++)
+    for(auto& worker : s_workers)
     {
-	tickle();
+	tickleThread(worker->threadID);
     }
-    if(s_schedulerCoroutine){tickle();}
     if(s_schedulerCoroutine){s_schedulerCoroutine->resume();}
     std::vector<std::shared_ptr<Thread>> thrs;
     {
@@ -162,20 +789,93 @@ void Scheduler::stop()
     }
 }
 
-void Scheduler::tickle(){}
+bool Scheduler::unparkWorker(Worker* worker)
+{
+    bool expected = true;
+    if(!worker->parked.compare_exchange_strong(expected,false))
+    {
+	return false;
+    }
+    {
+	std::lock_guard<std::mutex> lock(worker->parkMutex);
+	worker->wakeup = true;
+    }
+    worker->parkCond.notify_one();
+    return true;
+}
+
+void Scheduler::tickle()
+{
+    if(!hasIdleThreads())
+    {
+	return;
+    }
+    for(auto& worker : s_workers)
+    {
+	if(worker->parked && unparkWorker(worker.get()))
+	{
+	    return;
+	}
+    }
+}
+
+void Scheduler::tickleThread(int thread)
+{
+    Worker* worker = getWorker(thread);
+    if(worker)
+    {
+	unparkWorker(worker);
+    }
+}
+
+void Scheduler::tickleAllIfStopped()
+{
+    // 最后一个任务结束时唤醒所有还在idle中等待的线程，让它们尽快退出
+    if(s_stopping && stopping())
+    {
+	for(auto& worker : s_workers)
+	{
+	    tickleThread(worker->threadID);
+	}
+    }
+}
+
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
 
 void Scheduler::idle()
 {
+    Worker* self = t_worker;
     while(!stopping())
     {
-	sleep(1);
+	size_t spins = s_idleSpins;
+	for(size_t i = 0;i < spins && !hasPendingTask() && !stopping();i++)
+	{
+	    cpuRelax();
+	}
+	{
+	    std::unique_lock<std::mutex> lock(self->parkMutex);
+	    self->wakeup = false;
+	    // 先发布parked再检查任务，与提交任务后检查parked的tickle配对，避免错过唤醒
+	    self->parked = true;
+	    if(!hasPendingTask() && !stopping())
+	    {
+		self->parkCond.wait(lock,[self](){return self->wakeup;});
+	    }
+	    self->parked = false;
+	}
 	Coroutine::getCoroutine()->yield();
     }
 }
 
 bool Scheduler::stopping()
 {
-    std::lock_guard<std::mutex> lock(s_mutex);
-    return s_stopping && s_tasks.empty() && s_activateThreadCount == 0;
+    return s_stopping && s_taskCount == 0 && s_activateThreadCount == 0;
 }
 }
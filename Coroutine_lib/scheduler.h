@@ -10,14 +10,32 @@
 
 #include "coroutine.h"
 #include "thread.h"
+#include "workqueue.h"
+#include "histogram.h"
+#include "metrics.h"
+#include <chrono>
 #include <vector>
+#include <deque>
 #include <mutex>
+#include <condition_variable>
 #include <string>
+#include <iterator>
+#include <typeinfo>
 
 namespace Hourglass
 {
 class Scheduler
 {
+public:
+    //任务的优先级，数值越小越先执行
+    enum Priority
+    {
+	HIGH = 0,
+	NORMAL = 1,
+	LOW = 2,
+	PRIORITY_COUNT = 3
+    };
+
 private:
     //调度器的名字
     std::string s_name;
@@ -26,56 +44,185 @@ private:
     //线程池
     std::vector<std::shared_ptr<Thread>> s_threads;
     
-    //调度任务
+    //调度任务：只能移动，从提交到run()中取出执行都不拷贝函数对象
     struct SchedulerTask
     {
 	std::shared_ptr<Coroutine> coroutine;
-	std::function<void()> func;
+	InlineFunction func;
 	int thread;// 指定任务需要运行的线程id
+	size_t stackSize = 0;// 函数任务使用的栈大小，0为默认
+	int priority = NORMAL;// 优先级
+	int64_t deadline = 0;// 截止时间（steady_clock的纳秒数），0表示没有
+	uint64_t seq = 0;// 进入优先级队列的序号，截止时间相同时先提交的先执行
+	int64_t enqueueTime = 0;// 放入队列的时间，统计排队时延时才记录
+	const std::type_info* site = nullptr;// 提交的函数对象类型，栈用量测量时作为提交位置
 	
 	// 初始化构造函数 无参构造
 	SchedulerTask()
 	{
-	    coroutine = nullptr;
-	    func = nullptr;
 	    thread = -1;
 	}
 
 	// 有参构造 函数重载
+	// 共享栈协程只能回到绑定的线程上运行，绑定的线程优先于thr（例如reactor把就绪的fd固定在自己的线程上）
+	// 协程任务沿用协程上次运行时的优先级
 	SchedulerTask(std::shared_ptr<Coroutine> cp, int thr)
 	{
-	    coroutine = cp;
-	    thread = thr;
+	    coroutine = std::move(cp);
+	    thread = (coroutine && coroutine->getBoundThread() != -1) ? coroutine->getBoundThread() : thr;
+	    inherit();
 	}
 
 	SchedulerTask(std::shared_ptr<Coroutine>* cp, int thr)
 	{
 	    coroutine.swap(*cp);
-	    thread = thr;
+	    thread = (coroutine && coroutine->getBoundThread() != -1) ? coroutine->getBoundThread() : thr;
+	    inherit();
 	}
 
-	SchedulerTask(std::function<void()> function, int thr)
+	SchedulerTask(std::function<void()> *function, int thr)
 	{
-	    func = function;
+	    func = std::move(*function);
+	    *function = nullptr;
 	    thread = thr;
 	}
 
-	SchedulerTask(std::function<void()> *function, int thr)
+	// 其他函数对象：右值移动进来，左值拷贝一份
+	template <class F, class D = typename std::decay<F>::type,
+	    class = typename std::enable_if<!std::is_convertible<F,std::shared_ptr<Coroutine>>::value
+		&& !std::is_same<D,std::shared_ptr<Coroutine>*>::value && !std::is_same<D,std::function<void()>*>::value>::type>
+	SchedulerTask(F&& function, int thr):func(std::forward<F>(function)),thread(thr)
 	{
-	    func.swap(*function);
-	    thread = thr;
 	}
 
+	SchedulerTask(SchedulerTask&&) = default;
+	SchedulerTask& operator=(SchedulerTask&&) = default;
+
+	// 任务对象由每个线程的空闲链表分配，提交和执行在不同线程上时整批经过全局池周转
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
+	void inherit()
+	{
+	    if(coroutine)
+	    {
+		priority = coroutine->getPriority();
+		deadline = coroutine->getDeadline();
+	    }
+	}
+
+	// 不是NORMAL或者带截止时间的任务进入优先级队列
+	bool isPrioritized() const {return priority != NORMAL || deadline != 0;}
+
 	void reset()
 	{
 	    coroutine = nullptr;
 	    func = nullptr;
 	    thread = -1;
+	    stackSize = 0;
+	    priority = NORMAL;
+	    deadline = 0;
+	    enqueueTime = 0;
+	    site = nullptr;
 	}
     };
 
-    //任务队列
-    std::vector<SchedulerTask> s_tasks;
+    //全局注入队列：不在工作线程上提交的任务
+    RingQueue<SchedulerTask*> s_tasks;
+    //全局注入队列中的任务数，为0时工作线程不用加锁检查
+    std::atomic<size_t> s_globalCount = {0};
+    //所有队列中还没有被取走的任务数
+    std::atomic<size_t> s_taskCount = {0};
+    //其中指定了线程的任务数
+    std::atomic<size_t> s_pinnedCount = {0};
+
+    //每个优先级一个按(截止时间,序号)排列的小根堆，没有截止时间的排在有截止时间的之后（先来先服务）
+    //只放isPrioritized()的任务，普通任务仍然走工作窃取队列
+    struct PriorityLess
+    {
+	bool operator()(const SchedulerTask* a, const SchedulerTask* b) const
+	{
+	    int64_t da = a->deadline ? a->deadline : INT64_MAX;
+	    int64_t db = b->deadline ? b->deadline : INT64_MAX;
+	    return da != db ? da > db : a->seq > b->seq;
+	}
+    };
+    std::mutex s_priorityMutex;
+    std::vector<SchedulerTask*> s_priorityTasks[PRIORITY_COUNT];
+    std::atomic<size_t> s_priorityCount[PRIORITY_COUNT] = {};
+    uint64_t s_prioritySeq = 0;
+    //为HIGH任务保留的工作线程数
+    std::atomic<size_t> s_reservedWorkers = {0};
+    //正在运行共享队列中非HIGH任务的线程数，开启保留时才统计
+    std::atomic<size_t> s_normalRunning = {0};
+    //是否统计排队时延，以及每个优先级的排队时延
+    std::atomic<bool> s_queueDelayStats = {false};
+    LatencyHistogram s_queueDelay[PRIORITY_COUNT];
+
+    //工作线程：工作线程上提交的任务放入自己的队列，空闲时从其他线程的队列窃取
+    struct Worker
+    {
+	WorkStealingQueue<SchedulerTask*> queue;
+	size_t index = 0;
+	std::atomic<int> threadID = {-1};
+	//指定在该线程上运行的任务，其他线程不会看到
+	std::mutex mailboxMutex;
+	RingQueue<SchedulerTask*> mailbox;
+	std::atomic<size_t> mailboxCount = {0};
+	//基类idle的等待：parked由唤醒者CAS成false来认领，wakeup在parkMutex下设置
+	std::mutex parkMutex;
+	std::condition_variable parkCond;
+	std::atomic<bool> parked = {false};
+	bool wakeup = false;
+	//正在运行的任务占用了一个非HIGH名额
+	bool normalSlot = false;
+	//只有本线程写的计数器，单独占缓存行，读取时汇总
+	struct alignas(64) Stats
+	{
+	    LocalCounter tasks;//执行的任务数
+	    LocalCounter switches;//切换到任务协程或idle协程的次数
+	    LocalCounter idles;//进入idle的次数
+	    LocalCounter idleNs;//在idle中的时间
+	    LocalCounter steals;//从其他线程窃取到的任务数
+	    LocalCounter poolHits;
+	    LocalCounter poolMisses;
+	} stats;
+    };
+    //唤醒在基类idle中等待的Worker，返回是否认领成功
+    bool unparkWorker(Worker* worker);
+    //创建的线程依次占用前s_threadCount个，主线程占用最后一个
+    std::vector<std::unique_ptr<Worker>> s_workers;
+    //当前线程在所属调度器中的Worker
+    static thread_local Worker* t_worker;
+
+    //放入队列，返回需要唤醒的线程：-1表示任意空闲线程，-2表示不需要唤醒
+    int enqueue(SchedulerTask* task);
+    //按 本线程信箱 -> 本地队列 -> 全局队列 -> 窃取 的顺序取一个任务，tick用于定期优先检查全局队列
+    SchedulerTask* dequeue(Worker* self, uint64_t tick);
+    //批量放入队列，只加一次锁；指定了线程的任务逐个放入信箱并唤醒目标线程
+    //返回放入共享队列的任务数
+    size_t enqueueBatch(std::vector<SchedulerTask*>& tasks);
+    //按enqueue的返回值唤醒线程
+    void tickleTarget(int target)
+    {
+	if(target == -1){tickle();}
+	else if(target >= 0){tickleThread(target);}
+    }
+    //从全局队列中取一个任务
+    SchedulerTask* dequeueGlobal();
+    //从信箱中取一个任务
+    SchedulerTask* dequeueMailbox(Worker* self);
+    //放入对应优先级的堆
+    void enqueuePriority(SchedulerTask* task);
+    //从对应优先级的堆中取截止时间最早的任务
+    SchedulerTask* dequeuePriority(int priority);
+    //按保留的线程数占用一个运行非HIGH任务的名额，没有保留时总是成功
+    bool acquireNormalSlot(Worker* self);
+    void releaseNormalSlot(Worker* self);
+    //共享队列（除信箱以外）中是否有当前可以取的任务
+    bool hasSharedTask() const;
+    //根据线程id找到对应的Worker
+    Worker* getWorker(int thread_id) const;
     //存储工作线程的线程id
     std::vector<int> s_threadIDs;
     //需要额外创建的线程数
@@ -92,7 +239,27 @@ private:
     //如果是，记录主线程的id
     int s_rootThread = -1;
     //是否正在关闭
-    bool s_stopping = false;
+    std::atomic<bool> s_stopping = {false};
+
+    //每个工作线程缓存已结束的协程，通过Coroutine::reset复用，避免反复分配协程对象和栈
+    struct CoroutinePool
+    {
+	std::vector<std::shared_ptr<Coroutine>> coroutines;
+	//池中协程栈的总字节数
+	size_t bytes = 0;
+    };
+    //每个工作线程池中协程的最大个数
+    std::atomic<size_t> s_poolMaxCount = {64};
+    //每个工作线程池中协程栈的最大总字节数
+    std::atomic<size_t> s_poolMaxBytes = {16 * 1024 * 1024};
+    //回收时是否把栈的物理页归还给内核
+    std::atomic<bool> s_poolReleaseStacks = {true};
+    //进入等待前自旋检查任务的次数，0表示直接等待
+    std::atomic<size_t> s_idleSpins = {0};
+    //从池中取出栈分级相同的协程并绑定任务函数，没有时新建
+    std::shared_ptr<Coroutine> acquireCoroutine(CoroutinePool& pool, InlineFunction& func, size_t stack_size);
+    //回收已结束且没有其他持有者的协程
+    void recycleCoroutine(CoroutinePool& pool, std::shared_ptr<Coroutine>& cor);
 
 protected:
     // 设置正在运行的调度器
@@ -105,8 +272,26 @@ protected:
     virtual bool stopping();
 
     virtual void tickle();
+    // 每个任务让出或结束之后在工作线程上调用，处理任务留下的工作（如IOManager提交排队的io_uring请求）
+    virtual void afterTask() {}
+    // 只唤醒指定的线程，默认退化为tickle()
+    virtual void tickleThread(int thread);
+    // 调度器正在关闭且已经没有任务时唤醒所有线程
+    void tickleAllIfStopped();
 
     bool hasIdleThreads(){return s_idleThreadCount > 0;};
+    // 工作线程个数（包括作为工作线程的主线程）
+    size_t getWorkerCount() const {return s_workers.size();}
+    // 创建的工作线程个数，下标为[0, getThreadCount())，作为工作线程的主线程不计入
+    size_t getThreadCount() const {return s_threadCount;}
+    // 当前线程在本调度器中的下标，不是工作线程时返回-1
+    int getWorkerIndex() const;
+    // 线程id对应的工作线程下标，不存在时返回-1
+    int getWorkerIndex(int thread) const;
+    // 是否有当前线程可以执行的任务，进入idle之前再检查一次，避免错过唤醒
+    bool hasPendingTask() const;
+    // 采集指标，labels是每个值都带的标签（如scheduler="name"），子类追加自己的指标
+    virtual void collectMetrics(MetricsSnapshot& snapshot, const std::string& labels);
     
 public:
     // 构造函数
@@ -116,27 +301,107 @@ public:
     const std::string& getName() const {return s_name;};
     //获取正在运行的调度器
     static Scheduler* GetThis();
+    //当前线程是否是本调度器正在运行的工作线程（此时可以挂起当前协程）
+    bool inWorker() const {return getWorkerIndex() != -1;}
 
+    // stack_size 只对函数任务生效，指定执行该函数的协程栈大小（按StackAllocator分级），
+    // 传入 Coroutine::SHARED_STACK 时使用共享栈协程执行
+    // 函数对象按右值移动、按左值拷贝，不超过InlineFunction::INLINE_SIZE字节时不分配堆内存
     template <class CoroutineOrFunc>
-    void schedulerLock(CoroutineOrFunc cf, int thread=-1)
+    void schedulerLock(CoroutineOrFunc&& cf, int thread=-1, size_t stack_size=0)
     {
-	bool need_tickle;
+	SchedulerTask* task = new SchedulerTask(std::forward<CoroutineOrFunc>(cf),thread);
+	task->stackSize = stack_size;
+	task->site = &typeid(typename std::decay<CoroutineOrFunc>::type);
+	if(!task->coroutine && !task->func)
 	{
-	    std::lock_guard<std::mutex> lock(s_mutex);
-	    need_tickle = s_tasks.empty();
-	    SchedulerTask task(cf,thread);
-	    if(task.coroutine || task.func)
+	    delete task;
+	    return;
+	}
+	tickleTarget(enqueue(task));
+    }
+
+    // 按优先级提交：HIGH的任务先于NORMAL，NORMAL先于LOW；同一优先级中带截止时间的任务按截止时间
+    // 从早到晚执行（EDF），并先于不带截止时间的任务．优先级和截止时间会带到执行任务的协程上，
+    // 协程挂起后被重新调度时沿用．指定了线程的任务放入该线程的信箱，不参与排序
+    // LOW的任务只在没有其他任务时执行，持续有其他任务时会饿死．
+    // 不会抢占正在运行的任务：所有线程都在忙时，HIGH的任务在第一个线程的当前任务让出或结束后执行
+    template <class CoroutineOrFunc>
+    void schedulerPriority(CoroutineOrFunc&& cf, Priority priority,
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point(),
+	int thread=-1, size_t stack_size=0)
+    {
+	SchedulerTask* task = new SchedulerTask(std::forward<CoroutineOrFunc>(cf),thread);
+	task->stackSize = stack_size;
+	task->site = &typeid(typename std::decay<CoroutineOrFunc>::type);
+	if(!task->coroutine && !task->func)
+	{
+	    delete task;
+	    return;
+	}
+	task->priority = priority < HIGH || priority >= PRIORITY_COUNT ? NORMAL : priority;
+	task->deadline = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+	tickleTarget(enqueue(task));
+    }
+
+    // 批量提交协程或函数，元素按值取出（可以配合std::make_move_iterator避免拷贝）
+    // 只加一次锁，最多唤醒与新任务数相同个数的空闲线程
+    template <class InputIt>
+    void schedulerBatch(InputIt begin, InputIt end, int thread=-1)
+    {
+	std::vector<SchedulerTask*> tasks;
+	for(;begin != end;++begin)
+	{
+	    SchedulerTask* task = new SchedulerTask(*begin,thread);
+	    task->site = &typeid(typename std::iterator_traits<InputIt>::value_type);
+	    if(!task->coroutine && !task->func)
 	    {
-		s_tasks.push_back(task);
+		delete task;
+		continue;
 	    }
+	    tasks.push_back(task);
+	}
+	size_t wake = enqueueBatch(tasks);
+	for(size_t i = 0;i < wake && hasIdleThreads();i++)
+	{
+	    tickle();
 	}
-
-	if(need_tickle){tickle();}
     }
-    
 
     virtual void start();
     virtual void stop();
+
+    //设置每个工作线程协程池的上限，max_count或max_bytes为0时关闭复用
+    //release_stacks为true时，协程进入池中会通过madvise归还栈的物理页
+    void setCoroutinePool(size_t max_count, size_t max_bytes, bool release_stacks = true);
+    //空闲线程进入等待前先自旋检查spins次，适合任务频繁到达且核数充足的场景
+    void setIdleSpin(size_t spins) {s_idleSpins = spins;}
+    //已经取出执行的任务数
+    uint64_t getExecutedTasks() const;
+    //协程池命中次数
+    uint64_t getPoolHits() const;
+    //协程池未命中次数
+    uint64_t getPoolMisses() const;
+    //运行时指标的快照：队列深度、每个工作线程的任务数/切换次数/idle次数与时间等，IOManager还包括epoll与定时器
+    MetricsSnapshot getMetrics();
+    //Prometheus文本格式的指标
+    std::string dumpMetrics() {return getMetrics().toPrometheus();}
+    //把指标写入文件，可以由node_exporter的textfile collector等定期读取
+    bool writeMetrics(const std::string& path) {return getMetrics().writeFile(path);}
+    //为HIGH任务保留count个工作线程：同时运行共享队列中NORMAL和LOW任务的线程最多为工作线程数-count，
+    //HIGH任务到达时总有线程可以立即执行．至少留一个线程运行其他任务，指定了线程的任务不受限制
+    void setReservedWorkers(size_t count);
+    size_t getReservedWorkers() const {return s_reservedWorkers.load(std::memory_order_relaxed);}
+    //统计每个优先级从提交到开始执行的排队时延，开启后每个任务多两次读时钟
+    void setQueueDelayStats(bool enable) {s_queueDelayStats = enable;}
+    const LatencyHistogram& getQueueDelay(Priority priority) const {return s_queueDelay[priority];}
+    void resetQueueDelay()
+    {
+	for(auto& histogram : s_queueDelay)
+	{
+	    histogram.reset();
+	}
+    }
 };
 }
 #endif
@@ -0,0 +1,58 @@
+/*
+ - File Name: spinlock.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Fri 23 Oct 2026 10:14:52 AM CST
+ */
+
+#ifndef _SPINLOCK_H_
+#define _SPINLOCK_H_
+
+#include <atomic>
+#include <sched.h>
+
+namespace Hourglass
+{
+// 只占一个字节的自旋锁，用于临界区很短且竞争很少的场景（如每个fd的上下文）
+// 满足Lockable，可以配合std::lock_guard使用．自旋一段时间后让出CPU
+class SpinLock
+{
+private:
+    std::atomic<bool> m_locked = {false};
+
+public:
+    void lock()
+    {
+	for(int spins = 0;;spins++)
+	{
+	    if(!m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true,std::memory_order_acquire))
+	    {
+		return;
+	    }
+	    if(spins >= 64)
+	    {
+		sched_yield();
+	    }
+	    else
+	    {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	    }
+	}
+    }
+
+    bool try_lock()
+    {
+	return !m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true,std::memory_order_acquire);
+    }
+
+    void unlock()
+    {
+	m_locked.store(false,std::memory_order_release);
+    }
+};
+}
+#endif
@@ -0,0 +1,252 @@
+/*
+ - File Name: stack.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sat 17 Oct 2026 03:52:40 PM CST
+ */
+
+#include "stack.h"
+#include "histogram.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cxxabi.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+namespace Hourglass
+{
+size_t StackAllocator::pageSize()
+{
+    static const size_t page = sysconf(_SC_PAGESIZE);
+    return page;
+}
+
+size_t StackAllocator::roundSize(size_t size)
+{
+    if(size <= MIN_STACK_SIZE)
+    {
+	return MIN_STACK_SIZE;
+    }
+    if(size <= MAX_CLASS_SIZE)
+    {
+	size_t cls = MIN_STACK_SIZE;
+	while(cls < size)
+	{
+	    cls <<= 1;
+	}
+	return cls;
+    }
+    size_t page = pageSize();
+    return (size + page - 1) / page * page;
+}
+
+void* StackAllocator::allocate(size_t size)
+{
+    size_t page = pageSize();
+    void* base = mmap(nullptr, size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if(base == MAP_FAILED)
+    {
+	std::cerr << "StackAllocator::allocate mmap failed: " << strerror(errno) << std::endl;
+	throw std::bad_alloc();
+    }
+    if(mprotect(base, page, PROT_NONE))
+    {
+	std::cerr << "StackAllocator::allocate mprotect failed: " << strerror(errno) << std::endl;
+	munmap(base, size + page);
+	throw std::bad_alloc();
+    }
+    return (char*)base + page;
+}
+
+void StackAllocator::deallocate(void* stack, size_t size)
+{
+    if(!stack)
+    {
+	return;
+    }
+    size_t page = pageSize();
+    munmap((char*)stack - page, size + page);
+}
+
+void StackAllocator::release(void* stack, size_t size, size_t keep)
+{
+    size_t page = pageSize();
+    keep = (keep + page - 1) / page * page;
+    if(!stack || keep >= size)
+    {
+	return;
+    }
+    // MADV_FREE 只在内存紧张时才真正回收，再次写入不会缺页；旧内核不支持时退回 MADV_DONTNEED
+#ifdef MADV_FREE
+    static std::atomic<bool> free_supported = {true};
+    if(free_supported.load(std::memory_order_relaxed))
+    {
+	if(madvise(stack, size - keep, MADV_FREE) == 0)
+	{
+	    return;
+	}
+	if(errno == EINVAL)
+	{
+	    free_supported.store(false,std::memory_order_relaxed);
+	}
+    }
+#endif
+    madvise(stack, size - keep, MADV_DONTNEED);
+}
+
+static const uint64_t STACK_CANARY = 0x5afec0de5afec0deULL;
+static std::atomic<bool> s_profileEnabled{false};
+
+struct StackProfileEntry
+{
+    std::string name;
+    size_t maxUsed = 0;
+    size_t stackSize = 0;
+    // 桶边界是2的幂，用时延直方图记录字节数
+    LatencyHistogram used;
+};
+
+// 按tag或site的地址汇总，名字只在第一次出现时求一次
+static std::mutex s_profileMutex;
+static std::unordered_map<const void*,std::unique_ptr<StackProfileEntry>> s_profile;
+
+void StackProfiler::enable(bool on)
+{
+    s_profileEnabled = on;
+}
+
+bool StackProfiler::isEnabled()
+{
+    return s_profileEnabled.load(std::memory_order_relaxed);
+}
+
+// 栈上可能残留着ASan给上次运行的栈帧做的毒化标记，填充与扫描整个栈时不做检查
+__attribute__((no_sanitize_address))
+void StackProfiler::paint(void* stack, size_t size, size_t dirty)
+{
+    dirty = std::min((dirty + 7) & ~(size_t)7,size);
+    uint64_t* p = (uint64_t*)((char*)stack + size - dirty);
+    uint64_t* end = (uint64_t*)((char*)stack + size);
+    while(p < end)
+    {
+	*p++ = STACK_CANARY;
+    }
+}
+
+__attribute__((no_sanitize_address))
+size_t StackProfiler::measure(const void* stack, size_t size)
+{
+    const uint64_t* p = (const uint64_t*)stack;
+    const uint64_t* end = (const uint64_t*)((const char*)stack + size);
+    while(p < end && *p == STACK_CANARY)
+    {
+	++p;
+    }
+    return (const char*)end - (const char*)p;
+}
+
+static std::string siteName(const std::type_info* site)
+{
+    if(!site)
+    {
+	return "<unknown>";
+    }
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(site->name(),nullptr,nullptr,&status);
+    std::string name = status == 0 && demangled ? demangled : site->name();
+    free(demangled);
+    return name;
+}
+
+void StackProfiler::record(const char* tag, const std::type_info* site, size_t used, size_t size)
+{
+    const void* key = tag ? (const void*)tag : (const void*)site;
+    std::lock_guard<std::mutex> lock(s_profileMutex);
+    std::unique_ptr<StackProfileEntry>& entry = s_profile[key];
+    if(!entry)
+    {
+	entry.reset(new StackProfileEntry());
+	entry->name = tag ? tag : siteName(site);
+    }
+    entry->maxUsed = std::max(entry->maxUsed,used);
+    entry->stackSize = std::max(entry->stackSize,size);
+    entry->used.record(used);
+}
+
+std::vector<StackProfiler::Usage> StackProfiler::getUsage()
+{
+    std::vector<Usage> usages;
+    std::lock_guard<std::mutex> lock(s_profileMutex);
+    // 不同地址的同名标签（如不同编译单元里的字面量）合并到一起
+    for(auto& item : s_profile)
+    {
+	StackProfileEntry& entry = *item.second;
+	auto it = std::find_if(usages.begin(),usages.end(),[&entry](const Usage& usage){return usage.name == entry.name;});
+	if(it == usages.end())
+	{
+	    usages.emplace_back();
+	    it = usages.end() - 1;
+	    it->name = entry.name;
+	    it->buckets.assign(LatencyHistogram::BUCKETS,0);
+	}
+	std::vector<uint64_t> buckets = entry.used.getBuckets();
+	for(size_t i = 0;i < buckets.size();i++)
+	{
+	    it->buckets[i] += buckets[i];
+	}
+	it->count += entry.used.getCount();
+	it->avgUsed += entry.used.getSum();
+	it->maxUsed = std::max(it->maxUsed,entry.maxUsed);
+	it->stackSize = std::max(it->stackSize,entry.stackSize);
+    }
+    for(Usage& usage : usages)
+    {
+	usage.avgUsed = usage.count ? usage.avgUsed / usage.count : 0;
+	uint64_t seen = 0;
+	for(size_t i = 0;i < usage.buckets.size();i++)
+	{
+	    seen += usage.buckets[i];
+	    if(!usage.p50 && seen * 100 >= usage.count * 50)
+	    {
+		usage.p50 = LatencyHistogram::bucketBound(i);
+	    }
+	    if(!usage.p99 && seen * 100 >= usage.count * 99)
+	    {
+		usage.p99 = LatencyHistogram::bucketBound(i);
+	    }
+	}
+    }
+    std::sort(usages.begin(),usages.end(),[](const Usage& lhs, const Usage& rhs){return lhs.maxUsed > rhs.maxUsed;});
+    return usages;
+}
+
+std::string StackProfiler::dump()
+{
+    std::string out;
+    char buf[128];
+    snprintf(buf,sizeof(buf),"%10s %10s %10s %10s %10s %10s  %s\n","count","avg","p50","p99","max","stack","site");
+    out += buf;
+    for(const Usage& usage : getUsage())
+    {
+	snprintf(buf,sizeof(buf),"%10llu %10.0f %10llu %10llu %10zu %10zu  ",(unsigned long long)usage.count,usage.avgUsed,
+	    (unsigned long long)usage.p50,(unsigned long long)usage.p99,usage.maxUsed,usage.stackSize);
+	out += buf + usage.name + "\n";
+    }
+    return out;
+}
+
+void StackProfiler::reset()
+{
+    std::lock_guard<std::mutex> lock(s_profileMutex);
+    s_profile.clear();
+}
+}
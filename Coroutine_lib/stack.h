@@ -0,0 +1,79 @@
+/*
+ - File Name: stack.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sat 17 Oct 2026 03:36:11 PM CST
+ */
+
+#ifndef _STACK_H_
+#define _STACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace Hourglass
+{
+// 协程栈分配器
+// 使用mmap分配栈，栈底（低地址）放一个PROT_NONE的保护页，栈溢出时直接触发SIGSEGV而不是破坏堆．
+// 物理页在第一次访问时才提交，回收时通过MADV_FREE/MADV_DONTNEED归还给内核．
+class StackAllocator
+{
+public:
+    // 栈大小分级：16K 32K 64K 128K 256K 512K 1M，更大的按页对齐
+    static const size_t MIN_STACK_SIZE = 16 * 1024;
+    static const size_t MAX_CLASS_SIZE = 1024 * 1024;
+    // 把请求的大小向上取整到所在的分级
+    static size_t roundSize(size_t size);
+    // 分配size大小的可用栈（不含保护页），返回可用区域的低地址
+    static void* allocate(size_t size);
+    // 释放allocate得到的栈
+    static void deallocate(void* stack, size_t size);
+    // 保留映射，把栈中除栈顶keep字节外的物理页归还给内核
+    static void release(void* stack, size_t size, size_t keep = 0);
+    static size_t pageSize();
+};
+
+// 栈用量测量（调试用）：开启后协程栈在构造和reset时填充固定的图案，协程结束时从栈底向上找到第一个被改写的字，
+// 得到这次运行用到的最大深度，按标签（Coroutine::setStackTag）或提交任务的位置（函数对象的类型）汇总．
+// 填充会提交栈的全部物理页，只应在测量时开启；只分配了空间却没有写过的部分（如未使用的大数组）测不到，设置栈大小时要留余量．
+// 共享栈协程不参与测量
+class StackProfiler
+{
+public:
+    struct Usage
+    {
+	// 标签，没有标签时为提交任务的函数对象的类型名
+	std::string name;
+	// 测量的次数
+	uint64_t count = 0;
+	// 最大用量与平均用量（字节）
+	size_t maxUsed = 0;
+	double avgUsed = 0;
+	// 用量所在桶的上界，与StackAllocator的分级一样是2的幂
+	uint64_t p50 = 0;
+	uint64_t p99 = 0;
+	// 这些协程中最大的栈大小
+	size_t stackSize = 0;
+	// 第i个桶统计[2^(i-1), 2^i)字节
+	std::vector<uint64_t> buckets;
+    };
+
+    static void enable(bool on = true);
+    static bool isEnabled();
+    // 把[stack + size - dirty, stack + size)重新填充为图案，dirty之外的部分保持着上次填充的图案
+    static void paint(void* stack, size_t size, size_t dirty);
+    // 栈顶往下被改写过的字节数
+    static size_t measure(const void* stack, size_t size);
+    // tag为空时按site汇总，tag需要一直有效（如字符串字面量）
+    static void record(const char* tag, const std::type_info* site, size_t used, size_t size);
+    // 按名字合并后的用量，按最大用量从大到小排列
+    static std::vector<Usage> getUsage();
+    // 文本表格
+    static std::string dump();
+    static void reset();
+};
+}
+#endif
@@ -0,0 +1,354 @@
+/*
+ - File Name: sync.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Mon 26 Oct 2026 02:31:17 PM CST
+ */
+
+#include "sync.h"
+#include "ioscheduler.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Hourglass
+{
+static const std::chrono::nanoseconds NO_TIMEOUT(-1);
+
+void WaitQueue::checkTimeout(std::chrono::nanoseconds timeout)
+{
+    Scheduler* scheduler = Scheduler::GetThis();
+    if(timeout.count() >= 0 && scheduler && scheduler->inWorker() && !dynamic_cast<IOManager*>(scheduler))
+    {
+	throw std::logic_error("timed wait requires an IOManager");
+    }
+}
+
+std::shared_ptr<SyncWaiter> WaitQueue::prepare()
+{
+    std::shared_ptr<SyncWaiter> waiter = std::make_shared<SyncWaiter>();
+    Scheduler* scheduler = Scheduler::GetThis();
+    if(scheduler && scheduler->inWorker())
+    {
+	waiter->scheduler = scheduler;
+	waiter->coroutine = Coroutine::getCoroutine();
+    }
+    return waiter;
+}
+
+bool WaitQueue::claim(SyncWaiter* waiter)
+{
+    int expected = SyncWaiter::WAITING;
+    return waiter->state.compare_exchange_strong(expected,SyncWaiter::NOTIFIED);
+}
+
+void WaitQueue::resume(SyncWaiter* waiter)
+{
+    if(waiter->coroutine)
+    {
+	// 等待者可能还没有让出，调度器在c_mutex上等它让出后再恢复
+	waiter->scheduler->schedulerLock(waiter->coroutine);
+	return;
+    }
+    {
+	std::lock_guard<std::mutex> lock(waiter->mutex);
+    }
+    waiter->cond.notify_one();
+}
+
+bool WaitQueue::park(const std::shared_ptr<SyncWaiter>& waiter, std::chrono::nanoseconds timeout)
+{
+    if(waiter->coroutine)
+    {
+	std::shared_ptr<Timer> timer;
+	IOManager* iom = timeout.count() >= 0 ? dynamic_cast<IOManager*>(waiter->scheduler) : nullptr;
+	// 调用者已经用checkTimeout检查过
+	assert(timeout.count() < 0 || iom);
+	if(iom)
+	{
+	    std::weak_ptr<SyncWaiter> weak(waiter);
+	    timer = iom->addTimer(timeout,[weak]()
+	    {
+		std::shared_ptr<SyncWaiter> w = weak.lock();
+		int expected = SyncWaiter::WAITING;
+		if(w && w->state.compare_exchange_strong(expected,SyncWaiter::TIMEOUT))
+		{
+		    w->scheduler->schedulerLock(w->coroutine);
+		}
+	    });
+	}
+	waiter->coroutine->yield();
+	if(timer)
+	{
+	    timer->cancel();
+	}
+	return waiter->state == SyncWaiter::NOTIFIED;
+    }
+    // 不在调度器中，阻塞当前线程
+    std::unique_lock<std::mutex> lock(waiter->mutex);
+    auto woken = [&waiter](){return waiter->state != SyncWaiter::WAITING;};
+    if(timeout.count() < 0)
+    {
+	waiter->cond.wait(lock,woken);
+    }
+    else if(!waiter->cond.wait_for(lock,timeout,woken))
+    {
+	int expected = SyncWaiter::WAITING;
+	if(waiter->state.compare_exchange_strong(expected,SyncWaiter::TIMEOUT))
+	{
+	    return false;
+	}
+    }
+    return waiter->state == SyncWaiter::NOTIFIED;
+}
+
+bool WaitQueue::cancel(SyncWaiter* waiter)
+{
+    int expected = SyncWaiter::WAITING;
+    return waiter->state.compare_exchange_strong(expected,SyncWaiter::TIMEOUT);
+}
+
+std::shared_ptr<SyncWaiter> WaitQueue::enqueue()
+{
+    std::shared_ptr<SyncWaiter> waiter = prepare();
+    enqueue(waiter);
+    return waiter;
+}
+
+void WaitQueue::enqueue(const std::shared_ptr<SyncWaiter>& waiter)
+{
+    std::lock_guard<SpinLock> lock(m_mutex);
+    m_count.fetch_add(1);
+    m_waiters.push_back(waiter);
+}
+
+bool WaitQueue::remove(SyncWaiter* waiter)
+{
+    std::lock_guard<SpinLock> lock(m_mutex);
+    for(auto it = m_waiters.begin();it != m_waiters.end();++it)
+    {
+	if(it->get() == waiter)
+	{
+	    m_waiters.erase(it);
+	    m_count.fetch_sub(1);
+	    return true;
+	}
+    }
+    return false;
+}
+
+bool WaitQueue::wakeOne()
+{
+    if(m_count.load() == 0)
+    {
+	return false;
+    }
+    std::shared_ptr<SyncWaiter> waiter;
+    {
+	std::lock_guard<SpinLock> lock(m_mutex);
+	while(!m_waiters.empty())
+	{
+	    std::shared_ptr<SyncWaiter> front = std::move(m_waiters.front());
+	    m_waiters.pop_front();
+	    m_count.fetch_sub(1);
+	    if(claim(front.get()))
+	    {
+		waiter = std::move(front);
+		break;
+	    }
+	}
+    }
+    if(!waiter)
+    {
+	return false;
+    }
+    resume(waiter.get());
+    return true;
+}
+
+size_t WaitQueue::wakeAll()
+{
+    if(m_count.load() == 0)
+    {
+	return 0;
+    }
+    std::deque<std::shared_ptr<SyncWaiter>> waiters;
+    {
+	std::lock_guard<SpinLock> lock(m_mutex);
+	waiters.swap(m_waiters);
+	m_count.fetch_sub(waiters.size());
+    }
+    size_t woken = 0;
+    for(auto& waiter : waiters)
+    {
+	if(claim(waiter.get()))
+	{
+	    resume(waiter.get());
+	    woken++;
+	}
+    }
+    return woken;
+}
+
+bool Mutex::lockSlow(std::chrono::nanoseconds timeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    bool woken = false;
+    while(true)
+    {
+	std::chrono::nanoseconds left = NO_TIMEOUT;
+	if(timeout.count() >= 0)
+	{
+	    left = std::max(deadline - std::chrono::steady_clock::now(),std::chrono::steady_clock::duration::zero());
+	}
+	WaitQueue::Result result = m_queue.wait([this](){return tryTake();},left,woken);
+	if(result == WaitQueue::TAKEN)
+	{
+	    return true;
+	}
+	if(result == WaitQueue::TIMED_OUT)
+	{
+	    return false;
+	}
+	// 先清掉标志再抢锁，与unlock先放锁再检查标志配对
+	m_woken.store(false);
+	if(tryTake())
+	{
+	    return true;
+	}
+	woken = true;
+    }
+}
+
+void Mutex::lock()
+{
+    if(tryTake())
+    {
+	return;
+    }
+    lockSlow(NO_TIMEOUT);
+}
+
+bool Mutex::try_lock_for(std::chrono::nanoseconds timeout)
+{
+    return tryTake() || lockSlow(timeout);
+}
+
+void Mutex::unlock()
+{
+    assert(m_locked);
+    m_locked.store(false);
+    if(!m_queue.hasWaiters() || m_woken.exchange(true))
+    {
+	return;
+    }
+    if(!m_queue.wakeOne())
+    {
+	m_woken.store(false);
+    }
+}
+
+void ConditionVariable::wait(std::unique_lock<Mutex>& lock)
+{
+    // 先登记再解锁，解锁之后的notify不会丢失
+    std::shared_ptr<SyncWaiter> waiter = m_queue.enqueue();
+    lock.unlock();
+    WaitQueue::park(waiter,NO_TIMEOUT);
+    lock.lock();
+}
+
+bool ConditionVariable::wait_for(std::unique_lock<Mutex>& lock, std::chrono::nanoseconds timeout)
+{
+    WaitQueue::checkTimeout(timeout);
+    std::shared_ptr<SyncWaiter> waiter = m_queue.enqueue();
+    lock.unlock();
+    bool notified = WaitQueue::park(waiter,timeout);
+    if(!notified)
+    {
+	// 超时的等待者不会再被notify取走，自己从队列中删除
+	m_queue.remove(waiter.get());
+    }
+    lock.lock();
+    return notified;
+}
+
+void ConditionVariable::notify_one()
+{
+    m_queue.wakeOne();
+}
+
+void ConditionVariable::notify_all()
+{
+    m_queue.wakeAll();
+}
+
+bool Semaphore::tryTake()
+{
+    int64_t count = m_count.load(std::memory_order_relaxed);
+    while(count > 0)
+    {
+	if(m_count.compare_exchange_weak(count,count - 1))
+	{
+	    return true;
+	}
+    }
+    return false;
+}
+
+void Semaphore::acquire()
+{
+    if(tryTake())
+    {
+	return;
+    }
+    m_queue.wait([this](){return tryTake();},NO_TIMEOUT);
+}
+
+bool Semaphore::try_acquire_for(std::chrono::nanoseconds timeout)
+{
+    if(tryTake())
+    {
+	return true;
+    }
+    // 被唤醒时信号量已经由release转交给本等待者
+    return m_queue.wait([this](){return tryTake();},timeout) != WaitQueue::TIMED_OUT;
+}
+
+void Semaphore::release(int64_t count)
+{
+    assert(count > 0);
+    m_count.fetch_add(count);
+    m_queue.wake([this](){return tryTake();},[this](){m_count.fetch_add(1);});
+}
+
+void WaitGroup::add(int64_t count)
+{
+    int64_t now = m_count.fetch_add(count) + count;
+    if(now < 0)
+    {
+	std::cerr << "WaitGroup: negative counter" << std::endl;
+	assert(false);
+    }
+    if(now == 0)
+    {
+	m_queue.wakeAll();
+    }
+}
+
+void WaitGroup::wait()
+{
+    if(m_count.load() == 0)
+    {
+	return;
+    }
+    m_queue.wait([this](){return m_count.load() == 0;},NO_TIMEOUT);
+}
+
+bool WaitGroup::wait_for(std::chrono::nanoseconds timeout)
+{
+    if(m_count.load() == 0)
+    {
+	return true;
+    }
+    return m_queue.wait([this](){return m_count.load() == 0;},timeout) != WaitQueue::TIMED_OUT;
+}
+}
@@ -0,0 +1,246 @@
+/*
+ - File Name: sync.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Mon 26 Oct 2026 10:08:35 AM CST
+ */
+
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+#include "scheduler.h"
+#include "spinlock.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+// 协程同步原语：竞争时把当前协程挂到等待队列上并让出线程，被唤醒时通过schedulerLock重新调度，
+// 不会阻塞工作线程上的其他协程．不在调度器的工作线程上调用时退化为阻塞线程．
+// 带超时的等待使用所在IOManager的定时器，超时参数小于0表示一直等待．
+// 普通Scheduler没有定时器，在它的工作线程上带超时等待会抛出std::logic_error
+namespace Hourglass
+{
+// 一个等待者，由等待方分配，唤醒方与超时定时器通过CAS state决定谁负责唤醒
+struct SyncWaiter
+{
+    enum State
+    {
+	WAITING = 0,
+	NOTIFIED = 1,
+	TIMEOUT = 2
+    };
+    std::atomic<int> state = {WAITING};
+    // 协程等待
+    Scheduler* scheduler = nullptr;
+    std::shared_ptr<Coroutine> coroutine;
+    // 线程等待
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+// 等待队列：超时的等待者自己把自己从队列中删除，删除之前被唤醒方取到时跳过
+class WaitQueue
+{
+private:
+    SpinLock m_mutex;
+    std::deque<std::shared_ptr<SyncWaiter>> m_waiters;
+    // 队列中的等待者数，为0时唤醒方不用加锁
+    std::atomic<size_t> m_count = {0};
+
+    // 把等待者从WAITING改成NOTIFIED，已经超时的返回false
+    static bool claim(SyncWaiter* waiter);
+    // 唤醒已经认领的等待者，不持有队列的锁时调用
+    static void resume(SyncWaiter* waiter);
+
+public:
+    enum Result
+    {
+	// 登记时重试成功，没有挂起
+	TAKEN = 0,
+	// 被唤醒，用wake唤醒时资源已经转交给本等待者
+	WOKEN = 1,
+	TIMED_OUT = 2
+    };
+
+    // 先登记再调用try_take重试一次，与释放方先放回资源再检查m_count配对，避免错过唤醒
+    // front为true时排到队首（被唤醒后没抢到资源的等待者）
+    template <class TryTake>
+    Result wait(TryTake try_take, std::chrono::nanoseconds timeout, bool front = false)
+    {
+	checkTimeout(timeout);
+	std::shared_ptr<SyncWaiter> waiter = prepare();
+	{
+	    std::lock_guard<SpinLock> lock(m_mutex);
+	    m_count.fetch_add(1);
+	    std::atomic_thread_fence(std::memory_order_seq_cst);
+	    if(try_take())
+	    {
+		m_count.fetch_sub(1);
+		return TAKEN;
+	    }
+	    if(front)
+	    {
+		m_waiters.push_front(waiter);
+	    }
+	    else
+	    {
+		m_waiters.push_back(waiter);
+	    }
+	}
+	if(park(waiter,timeout))
+	{
+	    return WOKEN;
+	}
+	remove(waiter.get());
+	return TIMED_OUT;
+    }
+
+    // 释放资源之后调用：只要还有等待者并且try_take成功就把资源转交给队首的等待者，
+    // 队首已经超时时用give_back把资源放回去
+    template <class TryTake, class GiveBack>
+    void wake(TryTake try_take, GiveBack give_back)
+    {
+	if(m_count.load() == 0)
+	{
+	    return;
+	}
+	while(true)
+	{
+	    std::shared_ptr<SyncWaiter> waiter;
+	    {
+		std::lock_guard<SpinLock> lock(m_mutex);
+		if(m_waiters.empty() || !try_take())
+		{
+		    return;
+		}
+		waiter = std::move(m_waiters.front());
+		m_waiters.pop_front();
+		m_count.fetch_sub(1);
+		if(!claim(waiter.get()))
+		{
+		    give_back();
+		    continue;
+		}
+	    }
+	    resume(waiter.get());
+	}
+    }
+
+    // 不转交资源，唤醒所有的等待者，返回真正唤醒的个数
+    size_t wakeAll();
+    // 只把等待者登记到队列中，由调用者在释放其他锁之后调用park
+    std::shared_ptr<SyncWaiter> enqueue();
+    // 把同一个等待者登记到多个队列中（select），第一个唤醒它的队列生效
+    void enqueue(const std::shared_ptr<SyncWaiter>& waiter);
+    // 从队列中删除还没有被取出的等待者
+    bool remove(SyncWaiter* waiter);
+    // 唤醒队首的一个等待者，返回是否唤醒了
+    bool wakeOne();
+    // 是否可能有等待者（包括已经超时还没有取出的）
+    bool hasWaiters() const {return m_count.load() != 0;}
+
+    // 队列中的等待者数（包括已经超时还没有取出的）
+    size_t size() const {return m_count.load();}
+
+    // timeout大于等于0而当前在普通Scheduler的工作线程上时抛出std::logic_error，在登记等待者之前调用
+    static void checkTimeout(std::chrono::nanoseconds timeout);
+    // 按当前的执行环境（协程或线程）创建等待者
+    static std::shared_ptr<SyncWaiter> prepare();
+    // 等待者不再等待（没有挂起就拿到了资源），返回false说明已经被唤醒，调用者需要park把这次唤醒收掉
+    static bool cancel(SyncWaiter* waiter);
+    // 挂起直到被唤醒或超时，被唤醒返回true
+    static bool park(const std::shared_ptr<SyncWaiter>& waiter, std::chrono::nanoseconds timeout);
+};
+
+// 互斥锁：没有竞争时只有一次原子交换．解锁时不把锁转交给等待者，而是唤醒一个等待者去重新抢锁，
+// 正在运行的协程可以直接拿到锁，避免每次加锁都经过调度器；已经有被唤醒的等待者时不再唤醒，
+// 没抢到的等待者排回队首
+// 满足Lockable，可以配合std::lock_guard/std::unique_lock使用
+class Mutex
+{
+private:
+    std::atomic<bool> m_locked = {false};
+    // 是否有被唤醒还没有重新抢锁的等待者
+    std::atomic<bool> m_woken = {false};
+    WaitQueue m_queue;
+
+    bool tryTake() {return !m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true);}
+    bool lockSlow(std::chrono::nanoseconds timeout);
+
+public:
+    Mutex() = default;
+    Mutex(const Mutex&) = delete;
+    Mutex& operator=(const Mutex&) = delete;
+
+    void lock();
+    bool try_lock() {return tryTake();}
+    // 在timeout时间内拿到锁返回true
+    bool try_lock_for(std::chrono::nanoseconds timeout);
+    void unlock();
+};
+
+// 条件变量，配合Mutex使用
+class ConditionVariable
+{
+private:
+    WaitQueue m_queue;
+
+public:
+    void wait(std::unique_lock<Mutex>& lock);
+    template <class Predicate>
+    void wait(std::unique_lock<Mutex>& lock, Predicate pred)
+    {
+	while(!pred())
+	{
+	    wait(lock);
+	}
+    }
+    // 超时返回false，返回时都已经重新持有锁
+    bool wait_for(std::unique_lock<Mutex>& lock, std::chrono::nanoseconds timeout);
+    void notify_one();
+    void notify_all();
+    // 正在等待的协程或线程数
+    size_t waiterCount() const {return m_queue.size();}
+};
+
+// 计数信号量
+class Semaphore
+{
+private:
+    std::atomic<int64_t> m_count;
+    WaitQueue m_queue;
+
+    bool tryTake();
+
+public:
+    explicit Semaphore(int64_t count = 0):m_count(count){}
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+    void acquire();
+    bool try_acquire() {return tryTake();}
+    bool try_acquire_for(std::chrono::nanoseconds timeout);
+    void release(int64_t count = 1);
+    int64_t getCount() const {return m_count.load(std::memory_order_relaxed);}
+};
+
+// 等待一组任务完成：add登记任务数，每个任务结束时done，wait等到计数归零
+class WaitGroup
+{
+private:
+    std::atomic<int64_t> m_count = {0};
+    WaitQueue m_queue;
+
+public:
+    void add(int64_t count = 1);
+    void done() {add(-1);}
+    void wait();
+    // 超时返回false
+    bool wait_for(std::chrono::nanoseconds timeout);
+    int64_t getCount() const {return m_count.load(std::memory_order_relaxed);}
+};
+}
+#endif
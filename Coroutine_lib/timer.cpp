@@ -6,19 +6,26 @@
  */
 
 #include "timer.h"
+#include "trace.h"
+#include <algorithm>
 namespace Hourglass
 {
-Timer::Timer(uint64_t ms,std::function<void()> func,bool recurring,TimerManager* manager):
-m_ms(ms),m_recurring(recurring),m_func(func),m_manager(manager)
+Timer::Timer(std::chrono::nanoseconds interval,std::function<void()> func,bool recurring,TimerManager* manager):
+m_interval(interval),m_recurring(recurring),m_func(func),m_manager(manager)
 {
-    auto now = std::chrono::system_clock::now();
-    m_next = now + std::chrono::milliseconds(m_ms);
+    auto now = std::chrono::steady_clock::now();
+    m_next = now + m_interval;
 }
 
 bool Timer::Comparator::operator()(const std::shared_ptr<Timer>& lhs,const std::shared_ptr<Timer>& rhs) const
 {
     assert(lhs!=nullptr&&rhs!=nullptr);
-    return lhs->m_next < rhs->m_next;
+    // 到期时间相同的定时器按地址区分，否则后插入的会被set当成重复元素丢掉
+    if(lhs->m_next != rhs->m_next)
+    {
+	return lhs->m_next < rhs->m_next;
+    }
+    return lhs.get() < rhs.get();
 }
 
 bool Timer::cancel()
@@ -32,11 +39,8 @@ bool Timer::cancel()
     {
 	m_func = nullptr;
     }
-    auto it = m_manager->m_timers.find(shared_from_this());
-    if(it != m_manager->m_timers.end())
-    {
-	m_manager->m_timers.erase(it);
-    }
+    m_manager->eraseTimer(shared_from_this());
+    m_manager->m_cancelledCount++;
     return true;
 }
 
@@ -47,20 +51,19 @@ bool Timer::refresh()
     {
 	return false;
     }
-    auto it = m_manager->m_timers.find(shared_from_this());
-    if(it == m_manager->m_timers.end())
+    std::shared_ptr<Timer> self = shared_from_this();
+    if(!m_manager->eraseTimer(self))
     {
 	return false;
     }
-    m_manager->m_timers.erase(it);
-    m_next = std::chrono::system_clock::now() + std::chrono::milliseconds(m_ms);
-    m_manager->m_timers.insert(shared_from_this());
+    m_next = std::chrono::steady_clock::now() + m_interval;
+    m_manager->insertTimer(self);
     return true;
 }
 
 bool Timer::reset(uint64_t ms,bool from_now)
 {
-    if(ms == m_ms && !from_now)
+    if(std::chrono::milliseconds(ms) == m_interval && !from_now)
     {
 	return true;
     }
@@ -70,36 +73,51 @@ bool Timer::reset(uint64_t ms,bool from_now)
 	{
 	    return false;
 	}
-	auto it = m_manager->m_timers.find(shared_from_this());
-	if(it == m_manager->m_timers.end())
+	if(!m_manager->eraseTimer(shared_from_this()))
 	{
 	    return false;
 	}
-	m_manager->m_timers.erase(it);
     }
-    auto start = from_now ? std::chrono::system_clock::now() : m_next - std::chrono::milliseconds(m_ms);
-    m_ms = ms;
-    m_next = start + std::chrono::milliseconds(m_ms);
+    auto start = from_now ? std::chrono::steady_clock::now() : m_next - m_interval;
+    m_interval = std::chrono::milliseconds(ms);
+    m_next = start + m_interval;
     m_manager->addTimer(shared_from_this());
     return true;
 }
 
-TimerManager::TimerManager()
+TimerManager::TimerManager(Backend backend):m_backend(backend)
 {
-    m_previousTime = std::chrono::system_clock::now();
+    m_wheelBase = std::chrono::steady_clock::now();
 }
 
-TimerManager::~TimerManager(){};
+TimerManager::~TimerManager()
+{
+    // 轮中的定时器通过m_wheelSelf持有自己，需要手动断开
+    for(int i = 0;i < WHEEL_TOTAL;i++)
+    {
+	while(m_wheel[i])
+	{
+	    std::shared_ptr<Timer> timer = m_wheel[i]->m_wheelSelf;
+	    wheelUnlink(timer.get());
+	    timer->m_wheelSelf.reset();
+	}
+    }
+}
 
 bool TimerManager::hasTimer()
 {
     std::shared_lock<std::shared_mutex> read_lock(m_mutex);
-    return !m_timers.empty();
+    return m_backend == WHEEL ? m_wheelCount > 0 : !m_timers.empty();
 }
 
 std::shared_ptr<Timer> TimerManager::addTimer(uint64_t ms,std::function<void()> func,bool recurring)
 {
-    std::shared_ptr<Timer> timer(new Timer(ms,func,recurring,this));
+    return addTimer(std::chrono::milliseconds(ms),std::move(func),recurring);
+}
+
+std::shared_ptr<Timer> TimerManager::addTimer(std::chrono::nanoseconds timeout,std::function<void()> func,bool recurring)
+{
+    std::shared_ptr<Timer> timer(new Timer(timeout,std::move(func),recurring,this));
     addTimer(timer);
     return timer;
 }
@@ -123,8 +141,8 @@ void TimerManager::addTimer(std::shared_ptr<Timer> timer)
     bool at_front = false;
     {
 	std::unique_lock<std::shared_mutex> write_lock(m_mutex);
-	auto it = m_timers.insert(timer).first;
-	at_front = (it == m_timers.begin()) && !m_tickled;
+	m_addedCount++;
+	at_front = insertTimer(timer) && !m_tickled;
 	if(at_front)
 	{
 	    m_tickled = true;
@@ -136,53 +154,80 @@ void TimerManager::addTimer(std::shared_ptr<Timer> timer)
     }
 }
 
-bool TimerManager::detecClockRollover()
+std::chrono::steady_clock::time_point TimerManager::getNextDeadline()
 {
-    bool rollover = false;
-    auto now = std::chrono::system_clock::now();
-    if(now < (m_previousTime - std::chrono::milliseconds(60 * 60 * 1000)))
+    std::unique_lock<std::shared_mutex> write_lock(m_mutex);
+    m_tickled = false;
+    if(m_backend == WHEEL)
     {
-	rollover = true;
+	m_wheelNextHint = wheelNextExpire();
+	if(m_wheelNextHint == ~0ull)
+	{
+	    return std::chrono::steady_clock::time_point::max();
+	}
+	return m_wheelBase + std::chrono::milliseconds(m_wheelNextHint);
     }
-    m_previousTime = now;
-    return rollover;
+    if(m_timers.empty())
+    {
+	return std::chrono::steady_clock::time_point::max();
+    }
+    return (*m_timers.begin())->m_next;
 }
 
 uint64_t TimerManager::getNextTimer()
 {
-    std::shared_lock<std::shared_mutex> read_lock(m_mutex);
-    m_tickled = false;
-    if(m_timers.empty())
+    auto time = getNextDeadline();
+    if(time == std::chrono::steady_clock::time_point::max())
     {
 	return ~0ull;
     }
-    auto now = std::chrono::system_clock::now();
-    auto time = (*m_timers.begin())->m_next;
-    if(now>=time)
+    auto now = std::chrono::steady_clock::now();
+    if(now >= time)
     {
 	return 0;
     }
-    else
+    return static_cast<uint64_t>(std::chrono::ceil<std::chrono::milliseconds>(time - now).count());
+}
+
+uint64_t TimerManager::getNextTimerNs()
+{
+    auto time = getNextDeadline();
+    if(time == std::chrono::steady_clock::time_point::max())
     {
-	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(time-now);
-	return static_cast<uint64_t>(duration.count());
+	return ~0ull;
     }
-
+    auto now = std::chrono::steady_clock::now();
+    if(now >= time)
+    {
+	return 0;
+    }
+    return static_cast<uint64_t>((time - now).count());
 }
 
 void TimerManager::listExpiredFunc(std::vector<std::function<void()>>& funcs)
 {
-    auto now = std::chrono::system_clock::now();
+    auto now = std::chrono::steady_clock::now();
     std::unique_lock<std::shared_mutex> write_lock(m_mutex);
-    bool rollover = detecClockRollover();
-    while(!m_timers.empty() && rollover || !m_timers.empty() && (*m_timers.begin())->m_next <= now)
+    size_t before = funcs.size();
+    if(m_backend == WHEEL)
+    {
+	wheelExpire(now,funcs);
+	m_expiredCount += funcs.size() - before;
+	return;
+    }
+    bool trace = Tracer::isEnabled();
+    while(!m_timers.empty() && (*m_timers.begin())->m_next <= now)
     {
 	std::shared_ptr<Timer> temp = *m_timers.begin();
 	m_timers.erase(m_timers.begin());
+	if(trace)
+	{
+	    Tracer::record(Tracer::TIMER_FIRE,(uint64_t)temp.get(),std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - temp->m_next).count(),0));
+	}
 	funcs.push_back(temp->m_func);
 	if(temp->m_recurring)
 	{
-	    temp->m_next = now + std::chrono::milliseconds(temp->m_ms);
+	    temp->m_next = now + temp->m_interval;
 	    m_timers.insert(temp);
 	}
 	else
@@ -190,5 +235,251 @@ void TimerManager::listExpiredFunc(std::vector<std::function<void()>>& funcs)
 	    temp->m_func = nullptr;
 	}
     }
+    m_expiredCount += funcs.size() - before;
+}
+
+void TimerManager::collectTimerMetrics(MetricsSnapshot& snapshot, const std::string& labels)
+{
+    typedef MetricsSnapshot M;
+    std::shared_lock<std::shared_mutex> read_lock(m_mutex);
+    snapshot.add("hourglass_timers","Timers currently scheduled.",M::GAUGE,m_backend == WHEEL ? m_wheelCount : m_timers.size(),labels);
+    snapshot.add("hourglass_timers_added_total","Timers added, including reset().",M::COUNTER,m_addedCount,labels);
+    snapshot.add("hourglass_timers_expired_total","Timer callbacks collected for execution.",M::COUNTER,m_expiredCount,labels);
+    snapshot.add("hourglass_timers_cancelled_total","Timers cancelled before expiring.",M::COUNTER,m_cancelledCount,labels);
+}
+
+bool TimerManager::insertTimer(const std::shared_ptr<Timer>& timer)
+{
+    if(m_backend == WHEEL)
+    {
+	timer->m_expire = toTick(timer->m_next,true);
+	timer->m_wheelSelf = timer;
+	wheelLink(timer.get());
+	if(timer->m_expire < m_wheelNextHint)
+	{
+	    m_wheelNextHint = timer->m_expire;
+	    return true;
+	}
+	return false;
+    }
+    auto it = m_timers.insert(timer).first;
+    return it == m_timers.begin();
+}
+
+bool TimerManager::eraseTimer(const std::shared_ptr<Timer>& timer)
+{
+    if(m_backend == WHEEL)
+    {
+	if(timer->m_wheelSlot == -1)
+	{
+	    return false;
+	}
+	wheelUnlink(timer.get());
+	timer->m_wheelSelf.reset();
+	return true;
+    }
+    auto it = m_timers.find(timer);
+    if(it == m_timers.end())
+    {
+	return false;
+    }
+    m_timers.erase(it);
+    return true;
+}
+
+uint64_t TimerManager::toTick(std::chrono::steady_clock::time_point time, bool round_up) const
+{
+    if(time <= m_wheelBase)
+    {
+	return 0;
+    }
+    auto duration = time - m_wheelBase;
+    if(round_up)
+    {
+	return static_cast<uint64_t>(std::chrono::ceil<std::chrono::milliseconds>(duration).count());
+    }
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+}
+
+void TimerManager::wheelLink(Timer* timer)
+{
+    // 已经过期的定时器放在当前槽，下次推进时立即触发
+    uint64_t expire = std::max(timer->m_expire,m_wheelCurrent);
+    uint64_t delta = expire - m_wheelCurrent;
+    int slot = 0;
+    if(delta < (uint64_t)WHEEL_SLOTS0)
+    {
+	slot = expire & (WHEEL_SLOTS0 - 1);
+    }
+    else
+    {
+	for(int level = 1;level < WHEEL_LEVELS;level++)
+	{
+	    int limit = WHEEL_BITS0 + WHEEL_BITS * level;
+	    if(delta < (1ull << limit) || level == WHEEL_LEVELS - 1)
+	    {
+		if(delta >= (1ull << limit))
+		{
+		    // 超出范围，先放在最高层最远的槽，级联下来时再按真实到期时间放置
+		    expire = m_wheelCurrent + (1ull << limit) - 1;
+		}
+		int shift = limit - WHEEL_BITS;
+		slot = WHEEL_SLOTS0 + (level - 1) * WHEEL_SLOTS + ((expire >> shift) & (WHEEL_SLOTS - 1));
+		break;
+	    }
+	}
+    }
+    timer->m_wheelSlot = slot;
+    timer->m_wheelPrev = nullptr;
+    timer->m_wheelNext = m_wheel[slot];
+    if(m_wheel[slot])
+    {
+	m_wheel[slot]->m_wheelPrev = timer;
+    }
+    m_wheel[slot] = timer;
+    m_wheelBitmap[slot / 64] |= 1ull << (slot % 64);
+    m_wheelCount++;
+}
+
+void TimerManager::wheelUnlink(Timer* timer)
+{
+    int slot = timer->m_wheelSlot;
+    assert(slot >= 0);
+    if(timer->m_wheelPrev)
+    {
+	timer->m_wheelPrev->m_wheelNext = timer->m_wheelNext;
+    }
+    else
+    {
+	m_wheel[slot] = timer->m_wheelNext;
+    }
+    if(timer->m_wheelNext)
+    {
+	timer->m_wheelNext->m_wheelPrev = timer->m_wheelPrev;
+    }
+    if(!m_wheel[slot])
+    {
+	m_wheelBitmap[slot / 64] &= ~(1ull << (slot % 64));
+    }
+    timer->m_wheelPrev = timer->m_wheelNext = nullptr;
+    timer->m_wheelSlot = -1;
+    m_wheelCount--;
+}
+
+void TimerManager::wheelCascade(int level, size_t index)
+{
+    int slot = WHEEL_SLOTS0 + (level - 1) * WHEEL_SLOTS + index;
+    while(m_wheel[slot])
+    {
+	Timer* timer = m_wheel[slot];
+	wheelUnlink(timer);
+	wheelLink(timer);
+    }
+}
+
+int TimerManager::wheelFindNext(int level, size_t index) const
+{
+    size_t count = level == 0 ? WHEEL_SLOTS0 : WHEEL_SLOTS;
+    size_t offset = level == 0 ? 0 : WHEEL_SLOTS0 + (level - 1) * WHEEL_SLOTS;
+    // 每层的起点都按64对齐，一个字内的位不会跨层
+    for(size_t k = 0;k < count;)
+    {
+	size_t bit = offset + ((index + k) & (count - 1));
+	uint64_t word = m_wheelBitmap[bit / 64] >> (bit % 64);
+	if(word)
+	{
+	    return (int)(k + __builtin_ctzll(word));
+	}
+	k += 64 - bit % 64;
+    }
+    return -1;
+}
+
+uint64_t TimerManager::wheelNextExpire() const
+{
+    if(m_wheelCount == 0)
+    {
+	return ~0ull;
+    }
+    // 第0层的槽对应确切的到期tick，上层的槽只能给出下界，到时级联后再精确计算
+    uint64_t next = ~0ull;
+    int distance = wheelFindNext(0,m_wheelCurrent & (WHEEL_SLOTS0 - 1));
+    if(distance >= 0)
+    {
+	next = m_wheelCurrent + distance;
+    }
+    for(int level = 1;level < WHEEL_LEVELS;level++)
+    {
+	int shift = WHEEL_BITS0 + WHEEL_BITS * (level - 1);
+	// 当前正好在块的起点时，这个块对应的槽还没有级联，也要算进去
+	uint64_t block = (m_wheelCurrent + (1ull << shift) - 1) >> shift;
+	distance = wheelFindNext(level,block & (WHEEL_SLOTS - 1));
+	if(distance >= 0)
+	{
+	    next = std::min(next,(block + distance) << shift);
+	}
+    }
+    return next;
+}
+
+void TimerManager::wheelExpire(std::chrono::steady_clock::time_point now, std::vector<std::function<void()>>& funcs)
+{
+    std::vector<std::shared_ptr<Timer>> expired;
+    uint64_t now_tick = toTick(now,false);
+    while(m_wheelCurrent <= now_tick)
+    {
+	if(m_wheelCount == 0)
+	{
+	    m_wheelCurrent = now_tick + 1;
+	    break;
+	}
+	size_t index = m_wheelCurrent & (WHEEL_SLOTS0 - 1);
+	if(index == 0)
+	{
+	    for(int level = 1;level < WHEEL_LEVELS;level++)
+	    {
+		int shift = WHEEL_BITS0 + WHEEL_BITS * (level - 1);
+		size_t slot = (m_wheelCurrent >> shift) & (WHEEL_SLOTS - 1);
+		wheelCascade(level,slot);
+		if(slot != 0)
+		{
+		    break;
+		}
+	    }
+	}
+	if(!m_wheel[index])
+	{
+	    // 跳过本圈内的空槽，但不能越过下一次级联
+	    int distance = wheelFindNext(0,index);
+	    uint64_t skip = (distance > 0 && index + distance < (size_t)WHEEL_SLOTS0) ? distance : WHEEL_SLOTS0 - index;
+	    m_wheelCurrent = std::min(m_wheelCurrent + skip,now_tick + 1);
+	    continue;
+	}
+	while(m_wheel[index])
+	{
+	    Timer* timer = m_wheel[index];
+	    wheelUnlink(timer);
+	    expired.push_back(std::move(timer->m_wheelSelf));
+	}
+	m_wheelCurrent++;
+    }
+    bool trace = Tracer::isEnabled();
+    for(auto& timer : expired)
+    {
+	if(trace)
+	{
+	    Tracer::record(Tracer::TIMER_FIRE,(uint64_t)timer.get(),std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - timer->m_next).count(),0));
+	}
+	funcs.push_back(timer->m_func);
+	if(timer->m_recurring)
+	{
+	    timer->m_next = now + timer->m_interval;
+	    insertTimer(timer);
+	}
+	else
+	{
+	    timer->m_func = nullptr;
+	}
+    }
 }
 }
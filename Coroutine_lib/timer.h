@@ -12,6 +12,8 @@
 #include <assert.h>
 #include <functional>
 #include <mutex>
+#include <chrono>
+#include "metrics.h"
 
 namespace Hourglass
 {
@@ -22,10 +24,11 @@ class Timer:public std::enable_shared_from_this<Timer>
     friend class TimerManager;
 
 private:
-    Timer(uint64_t ms,std::function<void()> func,bool recurring,TimerManager* manager);
+    Timer(std::chrono::nanoseconds interval,std::function<void()> func,bool recurring,TimerManager* manager);
     bool m_recurring = false;
-    uint64_t m_ms = 0;
-    std::chrono::time_point<std::chrono::system_clock> m_next;
+    // 超时间隔与到期时间都基于单调时钟，精度为纳秒
+    std::chrono::nanoseconds m_interval{0};
+    std::chrono::steady_clock::time_point m_next;
     std::function<void()> m_func;
     TimerManager* m_manager = nullptr;
     struct Comparator
@@ -33,6 +36,15 @@ private:
 	bool operator()(const std::shared_ptr<Timer>& lhs,const std::shared_ptr<Timer>& rhs) const;
     };
 
+    // 时间轮后端：定时器挂在槽的双向链表上，在轮中时通过m_wheelSelf保持存活
+    Timer* m_wheelPrev = nullptr;
+    Timer* m_wheelNext = nullptr;
+    // 所在槽的下标，-1表示不在轮中
+    int m_wheelSlot = -1;
+    // 到期的tick（毫秒）
+    uint64_t m_expire = 0;
+    std::shared_ptr<Timer> m_wheelSelf;
+
 public:
     bool cancel();
     bool refresh();
@@ -42,23 +54,81 @@ public:
 class TimerManager
 {
     friend class Timer;
+public:
+    // 定时器的存储方式
+    // SET:   按到期时间排序的std::set，增删都是O(log n)
+    // WHEEL: 分层时间轮，1ms精度，增删和刷新都是O(1)，适合大量频繁刷新的超时定时器
+    enum Backend
+    {
+	SET = 0,
+	WHEEL = 1
+    };
+
 private:
-    bool detecClockRollover();
     std::shared_mutex m_mutex;
     std::set<std::shared_ptr<Timer>,Timer::Comparator> m_timers;
     bool m_tickled = false;
-    std::chrono::time_point<std::chrono::system_clock> m_previousTime;
+    Backend m_backend = SET;
+
+    // 分层时间轮：精度为1ms，到期时间向上取整到tick；第0层256个1ms的槽，之上3层各64个槽，每层槽的跨度是下一层的整圈
+    // 超出最高层范围的定时器先放在最高层，到时再重新分配
+    static const int WHEEL_BITS0 = 8;
+    static const int WHEEL_BITS = 6;
+    static const int WHEEL_LEVELS = 4;
+    static const int WHEEL_SLOTS0 = 1 << WHEEL_BITS0;
+    static const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+    static const int WHEEL_TOTAL = WHEEL_SLOTS0 + (WHEEL_LEVELS - 1) * WHEEL_SLOTS;
+    Timer* m_wheel[WHEEL_TOTAL] = {};
+    // 每个槽是否非空，用于快速找到下一个到期的槽
+    uint64_t m_wheelBitmap[WHEEL_TOTAL / 64] = {};
+    // tick 0 对应的时间
+    std::chrono::steady_clock::time_point m_wheelBase;
+    // 小于m_wheelCurrent的tick都已经处理过
+    uint64_t m_wheelCurrent = 0;
+    size_t m_wheelCount = 0;
+    // 上次getNextTimer算出的最早到期tick，新定时器更早时需要通知
+    uint64_t m_wheelNextHint = ~0ull;
+    // 加入（包括reset）、到期执行（周期定时器每次都算）和取消的定时器数，持有m_mutex时修改
+    uint64_t m_addedCount = 0;
+    uint64_t m_expiredCount = 0;
+    uint64_t m_cancelledCount = 0;
+
+    // 以下函数调用前需要持有m_mutex
+    // 放入定时器，返回是否成为最早到期的定时器
+    bool insertTimer(const std::shared_ptr<Timer>& timer);
+    // 取出定时器，不存在时返回false
+    bool eraseTimer(const std::shared_ptr<Timer>& timer);
+    // 时间换算成tick，round_up为true时向上取整（用于到期时间）
+    uint64_t toTick(std::chrono::steady_clock::time_point time, bool round_up) const;
+    void wheelLink(Timer* timer);
+    void wheelUnlink(Timer* timer);
+    // 把第level层的一个槽重新分配到下层
+    void wheelCascade(int level, size_t index);
+    // 第level层从index开始（循环）的第一个非空槽相对index的距离，没有时返回-1
+    int wheelFindNext(int level, size_t index) const;
+    uint64_t wheelNextExpire() const;
+    void wheelExpire(std::chrono::steady_clock::time_point now, std::vector<std::function<void()>>& funcs);
 
 protected:
     virtual void onTimerInsertAtFront() {};
     void addTimer(std::shared_ptr<Timer> timer);
+    // 最近一个定时器的到期时间，没有定时器时返回time_point::max()
+    std::chrono::steady_clock::time_point getNextDeadline();
+    // 定时器个数和增删计数
+    void collectTimerMetrics(MetricsSnapshot& snapshot, const std::string& labels);
 public:
-    TimerManager();
+    explicit TimerManager(Backend backend = SET);
     virtual ~TimerManager();
     std::shared_ptr<Timer> addTimer(uint64_t ms, std::function<void()> func, bool recurring = false);
+    // 纳秒精度的定时器，如std::chrono::microseconds(200)
+    std::shared_ptr<Timer> addTimer(std::chrono::nanoseconds timeout, std::function<void()> func, bool recurring = false);
     std::shared_ptr<Timer> addConditionTimer(uint64_t ms,std::function<void()> func,std::weak_ptr<void> weak_cond,bool recurring=false);
+    // 距离最近一个定时器到期的毫秒数（向上取整），没有定时器时返回~0ull
     uint64_t getNextTimer();
+    // 距离最近一个定时器到期的纳秒数，没有定时器时返回~0ull
+    uint64_t getNextTimerNs();
     void listExpiredFunc(std::vector<std::function<void()>>& funcs);
     bool hasTimer();
+    Backend getTimerBackend() const {return m_backend;}
 };
 }
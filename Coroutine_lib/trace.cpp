@@ -0,0 +1,239 @@
+/*
+ - File Name: trace.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sun 01 Nov 2026 02:46:31 PM CST
+ */
+
+#include "trace.h"
+#include "metrics.h"
+#include "thread.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+namespace Hourglass
+{
+std::atomic<bool> Tracer::s_enabled{false};
+
+// 导出线程可能与写者同时访问同一个槽，字段都用relaxed原子量，读到的撕裂记录靠重新检查head丢掉
+struct TraceRecord
+{
+    std::atomic<int64_t> time;
+    std::atomic<uint64_t> id;
+    std::atomic<uint64_t> arg0;
+    std::atomic<uint64_t> arg1;
+    std::atomic<uint32_t> type;
+};
+
+// 只有所属线程写；线程退出后保留到clear，以便导出
+struct TraceBuffer
+{
+    pid_t threadID = 0;
+    std::string threadName;
+    uint64_t mask = 0;
+    std::unique_ptr<TraceRecord[]> records;
+    // 写过的记录总数，第i条记录在records[i & mask]
+    std::atomic<uint64_t> head{0};
+    // clear时的head，之前的记录不再导出
+    std::atomic<uint64_t> start{0};
+    std::atomic<bool> exited{false};
+};
+
+// 线程退出时标记缓冲区，clear时回收
+struct TraceBufferHolder
+{
+    std::shared_ptr<TraceBuffer> buffer;
+    ~TraceBufferHolder()
+    {
+	if(buffer)
+	{
+	    buffer->exited = true;
+	}
+    }
+};
+
+static std::mutex s_buffersMutex;
+static std::vector<std::shared_ptr<TraceBuffer>> s_buffers;
+static std::atomic<size_t> s_capacity{65536};
+static thread_local TraceBufferHolder t_trace;
+// 记录时只读这个指针，避免每次经过带析构函数的thread_local的初始化检查
+static thread_local TraceBuffer* t_buffer = nullptr;
+
+static TraceBuffer* createBuffer()
+{
+    std::shared_ptr<TraceBuffer> buffer = std::make_shared<TraceBuffer>();
+    size_t capacity = 1;
+    while(capacity < s_capacity.load(std::memory_order_relaxed))
+    {
+	capacity <<= 1;
+    }
+    buffer->threadID = Thread::GetThreadID();
+    buffer->threadName = Thread::GetName();
+    buffer->mask = capacity - 1;
+    buffer->records.reset(new TraceRecord[capacity]);
+    {
+	std::lock_guard<std::mutex> lock(s_buffersMutex);
+	s_buffers.push_back(buffer);
+    }
+    t_trace.buffer = buffer;
+    t_buffer = buffer.get();
+    return t_buffer;
+}
+
+void Tracer::enable(size_t capacity)
+{
+    s_capacity = capacity ? capacity : 1;
+    s_enabled = true;
+}
+
+void Tracer::disable()
+{
+    s_enabled = false;
+}
+
+void Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(s_buffersMutex);
+    size_t n = 0;
+    for(auto& buffer : s_buffers)
+    {
+	if(buffer->exited)
+	{
+	    continue;
+	}
+	buffer->start = buffer->head.load(std::memory_order_acquire);
+	s_buffers[n++] = buffer;
+    }
+    s_buffers.resize(n);
+}
+
+void Tracer::record(Type type, uint64_t id, uint64_t arg0, uint64_t arg1)
+{
+    TraceBuffer* buffer = t_buffer;
+    if(!buffer)
+    {
+	buffer = createBuffer();
+    }
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    TraceRecord& slot = buffer->records[head & buffer->mask];
+    // 与导出时的acquire栅栏配对：导出线程读到这次写入的任何字段，就一定能看到head已经到了这个位置
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+	std::chrono::steady_clock::now().time_since_epoch()).count(),std::memory_order_relaxed);
+    slot.id.store(id,std::memory_order_relaxed);
+    slot.arg0.store(arg0,std::memory_order_relaxed);
+    slot.arg1.store(arg1,std::memory_order_relaxed);
+    slot.type.store(type,std::memory_order_relaxed);
+    buffer->head.store(head + 1,std::memory_order_release);
+}
+
+static const char* eventName(uint64_t event)
+{
+    return event == 0x1 ? "read" : event == 0x4 ? "write" : "none";
+}
+
+std::string Tracer::toChromeJson()
+{
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    {
+	std::lock_guard<std::mutex> lock(s_buffersMutex);
+	buffers = s_buffers;
+    }
+    int pid = getpid();
+    char buf[256];
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    snprintf(buf,sizeof(buf),"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"hourglass\"}}",pid);
+    out += buf;
+    struct Copy
+    {
+	int64_t time;
+	uint64_t id, arg0, arg1;
+	uint32_t type;
+    };
+    std::vector<Copy> copies;
+    for(auto& buffer : buffers)
+    {
+	uint64_t capacity = buffer->mask + 1;
+	uint64_t end = buffer->head.load(std::memory_order_acquire);
+	uint64_t begin = std::max(buffer->start.load(std::memory_order_relaxed),end > capacity ? end - capacity : 0);
+	copies.clear();
+	for(uint64_t i = begin;i < end;i++)
+	{
+	    TraceRecord& slot = buffer->records[i & buffer->mask];
+	    copies.push_back({slot.time.load(std::memory_order_relaxed),slot.id.load(std::memory_order_relaxed),
+		slot.arg0.load(std::memory_order_relaxed),slot.arg1.load(std::memory_order_relaxed),
+		slot.type.load(std::memory_order_relaxed)});
+	}
+	// 拷贝期间写者又写了多少条，被覆盖的槽丢掉
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t now = buffer->head.load(std::memory_order_relaxed);
+	size_t skip = now - begin >= capacity ? now - begin - capacity + 1 : 0;
+
+	std::string name;
+	for(char c : buffer->threadName)
+	{
+	    if(c == '"' || c == '\\')
+	    {
+		name += '\\';
+	    }
+	    name += c;
+	}
+	snprintf(buf,sizeof(buf),",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"",pid,buffer->threadID);
+	out += buf + name + "\"}}";
+	// 环形缓冲区开头可能只剩下E，没有对应的B
+	int depth = 0;
+	for(size_t i = skip;i < copies.size();i++)
+	{
+	    const Copy& c = copies[i];
+	    double ts = c.time / 1e3;
+	    switch(c.type)
+	    {
+	    case RESUME:
+		depth++;
+		snprintf(buf,sizeof(buf),",\n{\"name\":\"coroutine %" PRId64 "\",\"cat\":\"coroutine\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+		    "\"args\":{\"id\":%" PRId64 "}}",(int64_t)c.id,ts,pid,buffer->threadID,(int64_t)c.id);
+		break;
+	    case YIELD:
+		if(depth == 0)
+		{
+		    continue;
+		}
+		depth--;
+		snprintf(buf,sizeof(buf),",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"term\":%d}}",
+		    ts,pid,buffer->threadID,c.arg0 ? 1 : 0);
+		break;
+	    case SPAWN:
+		snprintf(buf,sizeof(buf),",\n{\"name\":\"spawn\",\"cat\":\"scheduler\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+		    "\"args\":{\"id\":%" PRId64 ",\"parent\":%" PRId64 "}}",ts,pid,buffer->threadID,(int64_t)c.id,(int64_t)c.arg0);
+		break;
+	    case EVENT_WAIT:
+	    case EVENT_TRIGGER:
+		snprintf(buf,sizeof(buf),",\n{\"name\":\"%s\",\"cat\":\"io\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+		    "\"args\":{\"id\":%" PRId64 ",\"fd\":%d,\"event\":\"%s\"}}",c.type == EVENT_WAIT ? "event_wait" : "event_trigger",
+		    ts,pid,buffer->threadID,(int64_t)c.id,(int)c.arg0,eventName(c.arg1));
+		break;
+	    case TIMER_FIRE:
+		snprintf(buf,sizeof(buf),",\n{\"name\":\"timer_fire\",\"cat\":\"timer\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+		    "\"args\":{\"timer\":\"0x%" PRIx64 "\",\"late_us\":%.3f}}",ts,pid,buffer->threadID,c.id,c.arg0 / 1e3);
+		break;
+	    default:
+		continue;
+	    }
+	    out += buf;
+	}
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool Tracer::writeChromeJson(const std::string& path)
+{
+    return writeFileAtomic(path,toChromeJson());
+}
+}
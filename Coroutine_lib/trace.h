@@ -0,0 +1,55 @@
+/*
+ - File Name: trace.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sun 01 Nov 2026 02:17:08 PM CST
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace Hourglass
+{
+// 协程生命周期跟踪：开启后记录提交、恢复、让出、等待事件、事件触发和定时器到期，
+// 每条记录带协程id、线程id和时间戳，写入每个线程自己的环形缓冲区（单写者，无锁，写满后覆盖最旧的记录），
+// 可以导出为Chrome trace JSON（chrome://tracing 或 ui.perfetto.dev 打开）．
+// 关闭时每个埋点只有一次relaxed的原子读
+class Tracer
+{
+public:
+    enum Type
+    {
+	SPAWN = 0,// 任务进入调度队列 id为协程任务的协程id（函数任务为-1） arg0为提交者的协程id
+	RESUME = 1,// 切入协程 id为被恢复的协程
+	YIELD = 2,// 切出协程 arg0为1表示协程已经结束
+	EVENT_WAIT = 3,// 在fd上等待事件 id为等待的协程（回调为-1） arg0为fd arg1为事件
+	EVENT_TRIGGER = 4,// fd上的事件被触发或取消 参数同EVENT_WAIT
+	TIMER_FIRE = 5// 定时器到期 id为定时器的地址 arg0为比到期时间晚了多少纳秒
+    };
+
+private:
+    static std::atomic<bool> s_enabled;
+
+public:
+    static bool isEnabled() {return s_enabled.load(std::memory_order_relaxed);}
+    // 开启跟踪，capacity为每个线程缓冲区的记录数（向上取整到2的幂），只对之后第一次记录的线程生效
+    static void enable(size_t capacity = 65536);
+    // 关闭跟踪，已有的记录保留到clear
+    static void disable();
+    // 丢弃所有线程已有的记录
+    static void clear();
+    // 写一条记录，调用前先检查isEnabled
+    static void record(Type type, uint64_t id, uint64_t arg0 = 0, uint64_t arg1 = 0);
+
+    // 导出为Chrome trace JSON：RESUME/YIELD为同一线程上成对的B/E事件，其余为瞬时事件．
+    // 导出时其他线程可以继续写，导出过程中被覆盖的记录会被丢掉
+    static std::string toChromeJson();
+    // 用writeFileAtomic写入
+    static bool writeChromeJson(const std::string& path);
+};
+}
+#endif
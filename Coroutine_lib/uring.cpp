@@ -0,0 +1,175 @@
+/*
+ - File Name: uring.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Wed 21 Oct 2026 09:40:03 AM CST
+ */
+
+#include "uring.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+
+namespace Hourglass
+{
+static int sys_io_uring_setup(unsigned entries, io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup,entries,p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter,fd,to_submit,min_complete,flags,nullptr,0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register,fd,opcode,arg,nr_args);
+}
+
+IoUring::~IoUring()
+{
+    if(m_sqes)
+    {
+	munmap(m_sqes,m_sqesSize);
+    }
+    if(m_cqRing && m_cqRing != m_sqRing)
+    {
+	munmap(m_cqRing,m_cqRingSize);
+    }
+    if(m_sqRing)
+    {
+	munmap(m_sqRing,m_sqRingSize);
+    }
+    if(m_fd >= 0)
+    {
+	close(m_fd);
+    }
+}
+
+bool IoUring::init(unsigned entries)
+{
+    io_uring_params params;
+    memset(&params,0,sizeof(params));
+    int fd = sys_io_uring_setup(entries,&params);
+    if(fd < 0)
+    {
+	return false;
+    }
+    m_fd = fd;
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(single)
+    {
+	m_sqRingSize = m_cqRingSize = m_sqRingSize > m_cqRingSize ? m_sqRingSize : m_cqRingSize;
+    }
+    m_sqRing = mmap(nullptr,m_sqRingSize,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,fd,IORING_OFF_SQ_RING);
+    if(m_sqRing == MAP_FAILED)
+    {
+	m_sqRing = nullptr;
+	return false;
+    }
+    if(single)
+    {
+	m_cqRing = m_sqRing;
+    }
+    else
+    {
+	m_cqRing = mmap(nullptr,m_cqRingSize,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,fd,IORING_OFF_CQ_RING);
+	if(m_cqRing == MAP_FAILED)
+	{
+	    m_cqRing = nullptr;
+	    return false;
+	}
+    }
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = (io_uring_sqe*)mmap(nullptr,m_sqesSize,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,fd,IORING_OFF_SQES);
+    if(m_sqes == MAP_FAILED)
+    {
+	m_sqes = nullptr;
+	return false;
+    }
+    char* sq = (char*)m_sqRing;
+    m_sqHead = (unsigned*)(sq + params.sq_off.head);
+    m_sqTail = (unsigned*)(sq + params.sq_off.tail);
+    m_sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    m_sqEntries = *(unsigned*)(sq + params.sq_off.ring_entries);
+    m_sqArray = (unsigned*)(sq + params.sq_off.array);
+    char* cq = (char*)m_cqRing;
+    m_cqHead = (unsigned*)(cq + params.cq_off.head);
+    m_cqTail = (unsigned*)(cq + params.cq_off.tail);
+    m_cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    m_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+    m_sqeTail = m_sqeSubmitted = *m_sqTail;
+    // 没有NODROP时CQ溢出会丢失完成事件，协程将永远等不到结果
+    if(!(params.features & IORING_FEAT_NODROP) || !probe())
+    {
+	errno = EOPNOTSUPP;
+	return false;
+    }
+    return true;
+}
+
+bool IoUring::probe()
+{
+    const unsigned nops = IORING_OP_LAST;
+    size_t size = sizeof(io_uring_probe) + nops * sizeof(io_uring_probe_op);
+    io_uring_probe* p = (io_uring_probe*)calloc(1,size);
+    if(!p)
+    {
+	return false;
+    }
+    bool ok = sys_io_uring_register(m_fd,IORING_REGISTER_PROBE,p,nops) == 0;
+    const int needed[] = {IORING_OP_READ,IORING_OP_WRITE,IORING_OP_ACCEPT,IORING_OP_CONNECT,IORING_OP_TIMEOUT};
+    for(int op : needed)
+    {
+	if(!ok || op > p->last_op || !(p->ops[op].flags & IO_URING_OP_SUPPORTED))
+	{
+	    ok = false;
+	    break;
+	}
+    }
+    free(p);
+    return ok;
+}
+
+io_uring_sqe* IoUring::getSqe()
+{
+    unsigned head = __atomic_load_n(m_sqHead,__ATOMIC_ACQUIRE);
+    if(m_sqeTail - head >= m_sqEntries)
+    {
+	return nullptr;
+    }
+    io_uring_sqe* sqe = &m_sqes[m_sqeTail & m_sqMask];
+    m_sqArray[m_sqeTail & m_sqMask] = m_sqeTail & m_sqMask;
+    m_sqeTail++;
+    memset(sqe,0,sizeof(*sqe));
+    return sqe;
+}
+
+int IoUring::flush()
+{
+    unsigned to_submit = m_sqeTail - m_sqeSubmitted;
+    if(to_submit == 0)
+    {
+	return 0;
+    }
+    __atomic_store_n(m_sqTail,m_sqeTail,__ATOMIC_RELEASE);
+    int rt = 0;
+    do
+    {
+	rt = sys_io_uring_enter(m_fd,to_submit,0,0);
+    }
+    while(rt < 0 && errno == EINTR);
+    if(rt < 0)
+    {
+	return -errno;
+    }
+    m_sqeSubmitted += rt;
+    return rt;
+}
+}
@@ -0,0 +1,85 @@
+/*
+ - File Name: uring.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Wed 21 Oct 2026 09:12:36 AM CST
+ */
+
+#ifndef _URING_H_
+#define _URING_H_
+
+#include <linux/io_uring.h>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace Hourglass
+{
+// 直接通过系统调用使用io_uring，不依赖liburing
+// 本身不是线程安全的：提交端（getSqe/flush）需要调用者加锁，完成端（reap）同一时刻只能有一个线程调用
+class IoUring
+{
+public:
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // 创建ring并检查需要的操作是否都支持，失败返回false，errno说明原因
+    bool init(unsigned entries);
+    bool isValid() const {return m_fd >= 0;}
+    // ring的fd可以注册到epoll中，有完成事件时可读
+    int getFd() const {return m_fd;}
+
+    // 取一个空闲的SQE（已清零），SQ满时返回nullptr
+    io_uring_sqe* getSqe();
+    // 已经填好但还没有提交给内核的SQE个数
+    unsigned pending() const {return m_sqeTail - m_sqeSubmitted;}
+    // 一次io_uring_enter提交所有待提交的SQE，返回提交个数或-errno
+    int flush();
+
+    // 取出所有完成事件，对每个调用func(user_data, res)，返回个数
+    template <class F>
+    unsigned reap(F func)
+    {
+	unsigned head = *m_cqHead;
+	unsigned tail = __atomic_load_n(m_cqTail,__ATOMIC_ACQUIRE);
+	unsigned count = 0;
+	for(;head != tail;head++,count++)
+	{
+	    io_uring_cqe* cqe = &m_cqes[head & m_cqMask];
+	    func(cqe->user_data,cqe->res);
+	}
+	__atomic_store_n(m_cqHead,head,__ATOMIC_RELEASE);
+	return count;
+    }
+    // 是否有未取出的完成事件
+    bool hasCompletions() const {return *m_cqHead != __atomic_load_n(m_cqTail,__ATOMIC_ACQUIRE);}
+
+private:
+    bool probe();
+
+    int m_fd = -1;
+    // SQ ring
+    void* m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    // 本地的SQ尾和已经提交的位置
+    unsigned m_sqeTail = 0;
+    unsigned m_sqeSubmitted = 0;
+    // CQ ring，内核支持IORING_FEAT_SINGLE_MMAP时与SQ ring共用映射
+    void* m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+};
+}
+#endif
@@ -0,0 +1,162 @@
+/*
+ - File Name: workqueue.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sun 18 Oct 2026 09:47:30 AM CST
+ */
+
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+namespace Hourglass
+{
+// Chase-Lev 工作窃取队列（按 Lê 等人针对弱内存模型的版本实现）
+// 只有拥有者线程可以 push，任何线程都可以 steal．
+// 拥有者自己也从 top 端取任务，保证本线程内按提交顺序执行，
+// 否则一个反复把自己重新提交的协程会让队列里更早的任务饿死．
+// T 必须是可以放进 std::atomic 的简单类型（这里存放任务指针）．
+template <class T>
+class WorkStealingQueue
+{
+private:
+    struct Array
+    {
+	int64_t capacity;
+	int64_t mask;
+	std::unique_ptr<std::atomic<T>[]> slots;
+
+	explicit Array(int64_t cap):capacity(cap),mask(cap - 1),slots(new std::atomic<T>[cap]){}
+	T get(int64_t i) const {return slots[i & mask].load(std::memory_order_relaxed);}
+	void put(int64_t i, T v) {slots[i & mask].store(v,std::memory_order_relaxed);}
+	Array* grow(int64_t bottom, int64_t top) const
+	{
+	    Array* a = new Array(capacity * 2);
+	    for(int64_t i = top;i < bottom;i++)
+	    {
+		a->put(i,get(i));
+	    }
+	    return a;
+	}
+    };
+
+    alignas(64) std::atomic<int64_t> m_top = {0};
+    alignas(64) std::atomic<int64_t> m_bottom = {0};
+    alignas(64) std::atomic<Array*> m_array;
+    // 扩容后旧数组可能还有窃取者在读，延迟到析构时释放
+    std::vector<std::unique_ptr<Array>> m_retired;
+
+public:
+    explicit WorkStealingQueue(int64_t capacity = 256)
+    {
+	int64_t cap = 1;
+	while(cap < capacity)
+	{
+	    cap <<= 1;
+	}
+	m_array.store(new Array(cap),std::memory_order_relaxed);
+    }
+
+    ~WorkStealingQueue()
+    {
+	delete m_array.load(std::memory_order_relaxed);
+    }
+
+    WorkStealingQueue(const WorkStealingQueue&) = delete;
+    WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+    // 只能由拥有者线程调用
+    void push(T v)
+    {
+	int64_t b = m_bottom.load(std::memory_order_relaxed);
+	int64_t t = m_top.load(std::memory_order_acquire);
+	Array* a = m_array.load(std::memory_order_relaxed);
+	if(b - t > a->capacity - 1)
+	{
+	    Array* bigger = a->grow(b,t);
+	    m_retired.emplace_back(a);
+	    m_array.store(bigger,std::memory_order_release);
+	    a = bigger;
+	}
+	a->put(b,v);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(b + 1,std::memory_order_relaxed);
+    }
+
+    // 从 top 端取一个元素，成功返回 true．与其他线程竞争失败时也返回 false
+    bool steal(T& out)
+    {
+	int64_t t = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = m_bottom.load(std::memory_order_acquire);
+	if(t >= b)
+	{
+	    return false;
+	}
+	Array* a = m_array.load(std::memory_order_acquire);
+	T v = a->get(t);
+	if(!m_top.compare_exchange_strong(t,t + 1,std::memory_order_seq_cst,std::memory_order_relaxed))
+	{
+	    return false;
+	}
+	out = v;
+	return true;
+    }
+
+    // 近似大小，只用于判断是否为空和统计
+    size_t size() const
+    {
+	int64_t b = m_bottom.load(std::memory_order_relaxed);
+	int64_t t = m_top.load(std::memory_order_relaxed);
+	return b > t ? (size_t)(b - t) : 0;
+    }
+
+    bool empty() const {return size() == 0;}
+};
+
+// 由调用方加锁的环形FIFO队列，容量不够时翻倍，出队不释放内存．
+// 代替std::deque：后者每过一个节点就要分配、释放一次，这里容量稳定后入队出队都不再分配．
+// 出队的元素留在原处直到被覆盖，T应为任务指针这样的简单类型
+template <class T>
+class RingQueue
+{
+private:
+    std::vector<T> m_buffer;// 容量为2的幂
+    size_t m_head = 0;// 下一个出队的位置，只增不减
+    size_t m_tail = 0;// 下一个入队的位置
+
+    void grow()
+    {
+	size_t n = size();
+	std::vector<T> buffer(m_buffer.empty() ? 64 : m_buffer.size() * 2);
+	for(size_t i = 0;i < n;i++)
+	{
+	    buffer[i] = std::move(m_buffer[(m_head + i) & (m_buffer.size() - 1)]);
+	}
+	m_buffer.swap(buffer);
+	m_head = 0;
+	m_tail = n;
+    }
+
+public:
+    void push_back(T value)
+    {
+	if(size() == m_buffer.size())
+	{
+	    grow();
+	}
+	m_buffer[m_tail++ & (m_buffer.size() - 1)] = std::move(value);
+    }
+
+    T& front() {return m_buffer[m_head & (m_buffer.size() - 1)];}
+    void pop_front() {m_head++;}
+    size_t size() const {return m_tail - m_head;}
+    bool empty() const {return m_head == m_tail;}
+};
+}
+#endif
@@ -0,0 +1,73 @@
+/*
+ - File Name: bench_report.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sun 01 Nov 2026 09:12:33 AM CST
+ */
+
+#ifndef _BENCH_REPORT_H_
+#define _BENCH_REPORT_H_
+
+// 基准结果的机器可读输出：设置环境变量 HOURGLASS_BENCH_OUTPUT=<文件> 后，每个结果追加一行JSON（JSON Lines）:
+// {"bench":"context_switch","case":"coroutine","metric":"round_trip","value":35.2,"unit":"ns"}
+// 多个基准可以写同一个文件，便于回归对比．表格照常输出到stdout
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+class BenchReport
+{
+private:
+    std::string m_bench;
+    FILE* m_file = nullptr;
+
+    static std::string quote(const std::string& s)
+    {
+	std::string out = "\"";
+	for(char c : s)
+	{
+	    if(c == '"' || c == '\\')
+	    {
+		out += '\\';
+	    }
+	    out += c;
+	}
+	return out + "\"";
+    }
+
+public:
+    explicit BenchReport(const char* bench) : m_bench(bench)
+    {
+	const char* path = getenv("HOURGLASS_BENCH_OUTPUT");
+	if(path && *path)
+	{
+	    m_file = fopen(path, "a");
+	    if(!m_file)
+	    {
+		perror(path);
+	    }
+	}
+    }
+    ~BenchReport()
+    {
+	if(m_file)
+	{
+	    fclose(m_file);
+	}
+    }
+    BenchReport(const BenchReport&) = delete;
+    BenchReport& operator=(const BenchReport&) = delete;
+
+    // name为测量的场景（含参数，如 "external/threads=4"），metric为指标名
+    void add(const std::string& name, const char* metric, double value, const char* unit)
+    {
+	if(!m_file)
+	{
+	    return;
+	}
+	fprintf(m_file, "{\"bench\":%s,\"case\":%s,\"metric\":%s,\"value\":%.6g,\"unit\":%s}\n",
+	    quote(m_bench).c_str(), quote(name).c_str(), quote(metric).c_str(), value, quote(unit).c_str());
+	fflush(m_file);
+    }
+};
+#endif
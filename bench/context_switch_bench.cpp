@@ -0,0 +1,112 @@
+/*
+ - File Name: context_switch_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sat 17 Oct 2026 02:20:37 PM CST
+ */
+
+// 上下文切换开销: 对比 glibc swapcontext 与汇编后端，以及 Coroutine resume/yield 往返
+#include "coroutine.h"
+#include "trace.h"
+#include "bench_report.h"
+#include <ucontext.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace Hourglass;
+
+static const size_t STACK_SIZE = 64 * 1024;
+
+static ucontext_t g_ucMain, g_ucPeer;
+static void ucontextPeer()
+{
+    while(true)
+    {
+	swapcontext(&g_ucPeer, &g_ucMain);
+    }
+}
+
+static double benchUcontext(size_t rounds)
+{
+    std::vector<char> stack(STACK_SIZE);
+    getcontext(&g_ucPeer);
+    g_ucPeer.uc_link = nullptr;
+    g_ucPeer.uc_stack.ss_sp = stack.data();
+    g_ucPeer.uc_stack.ss_size = stack.size();
+    makecontext(&g_ucPeer, &ucontextPeer, 0);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < rounds;i++)
+    {
+	swapcontext(&g_ucMain, &g_ucPeer);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / rounds;
+}
+
+static Context g_ctxMain, g_ctxPeer;
+static void contextPeer()
+{
+    while(true)
+    {
+	swapContext(&g_ctxPeer, &g_ctxMain);
+    }
+}
+
+static double benchContext(size_t rounds)
+{
+    std::vector<char> stack(STACK_SIZE);
+    initContext(&g_ctxMain);
+    makeContext(&g_ctxPeer, stack.data(), stack.size(), &contextPeer);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < rounds;i++)
+    {
+	swapContext(&g_ctxMain, &g_ctxPeer);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / rounds;
+}
+
+static double benchCoroutine(size_t rounds)
+{
+    Coroutine::getCoroutine();
+    std::shared_ptr<Coroutine> cor = std::make_shared<Coroutine>([]()
+    {
+	while(true)
+	{
+	    Coroutine::getCoroutine()->yield();
+	}
+    }, 0, false);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < rounds;i++)
+    {
+	cor->resume();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / rounds;
+}
+
+int main(int argc, char** argv)
+{
+    size_t rounds = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    printf("backend: %s, rounds: %zu (one round = switch in + switch out)\n", contextBackend(), rounds);
+    BenchReport report("context_switch");
+    double ucontext = benchUcontext(rounds);
+    printf("%-24s %10.1f ns/round\n", "ucontext swapcontext", ucontext);
+    report.add("ucontext", "round_trip", ucontext, "ns");
+    double context = benchContext(rounds);
+    printf("%-24s %10.1f ns/round\n", "Context swapContext", context);
+    report.add(std::string("context/") + contextBackend(), "round_trip", context, "ns");
+    double coroutine = benchCoroutine(rounds);
+    printf("%-24s %10.1f ns/round\n", "Coroutine resume/yield", coroutine);
+    report.add("coroutine", "round_trip", coroutine, "ns");
+    // 开启跟踪后每个来回多写两条记录
+    Tracer::enable();
+    double traced = benchCoroutine(rounds);
+    Tracer::disable();
+    Tracer::clear();
+    printf("%-24s %10.1f ns/round\n", "  with tracing", traced);
+    report.add("coroutine/traced", "round_trip", traced, "ns");
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ - File Name: echo_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sun 01 Nov 2026 10:03:47 AM CST
+ */
+
+// 回环TCP回显：服务端与客户端跑在同一个IOManager上，connections个客户端协程各自在一条连接上
+// 发送requests个size字节的请求，等收齐回显后再发下一个，统计总的请求吞吐与单个请求的往返时延
+#include "ioscheduler.h"
+#include "bench_report.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <semaphore.h>
+#include <vector>
+
+using namespace Hourglass;
+
+static int tcpSocket()
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(fd < 0)
+    {
+	perror("socket");
+	exit(1);
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+// 读满count字节，对端关闭或出错时返回false
+static bool readFull(IOManager& iom, int fd, char* buf, size_t count)
+{
+    while(count > 0)
+    {
+	ssize_t n = iom.asyncRead(fd, buf, count);
+	if(n <= 0)
+	{
+	    return false;
+	}
+	buf += n;
+	count -= n;
+    }
+    return true;
+}
+
+static bool writeFull(IOManager& iom, int fd, const char* buf, size_t count)
+{
+    while(count > 0)
+    {
+	ssize_t n = iom.asyncWrite(fd, buf, count);
+	if(n <= 0)
+	{
+	    return false;
+	}
+	buf += n;
+	count -= n;
+    }
+    return true;
+}
+
+static void run(BenchReport& report, const char* backend, IOManager::IOBackend io_backend, size_t threads,
+    size_t connections, size_t requests, size_t size)
+{
+    IOManager iom(threads + 1, true, "echo", TimerManager::SET, io_backend);
+    if(iom.getIOBackend() != io_backend)
+    {
+	// 内核不支持io_uring时已经退回EPOLL，不再重复测量
+	iom.stop();
+	return;
+    }
+    int listen_fd = tcpSocket();
+    int on = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if(bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) || listen(listen_fd, 1024) || getsockname(listen_fd, (sockaddr*)&addr, &len))
+    {
+	perror("listen");
+	exit(1);
+    }
+
+    // 服务端：每条连接一个协程，读到多少回写多少
+    iom.schedulerLock([&iom, listen_fd, connections, size]()
+    {
+	for(size_t i = 0;i < connections;i++)
+	{
+	    int fd = iom.asyncAccept(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+	    if(fd < 0)
+	    {
+		perror("accept");
+		exit(1);
+	    }
+	    int on = 1;
+	    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	    iom.schedulerLock([&iom, fd, size]()
+	    {
+		std::vector<char> buf(size);
+		while(true)
+		{
+		    ssize_t n = iom.asyncRead(fd, buf.data(), buf.size());
+		    if(n <= 0 || !writeFull(iom, fd, buf.data(), n))
+		    {
+			break;
+		    }
+		}
+		iom.cancelAll(fd);
+		close(fd);
+	    });
+	}
+    });
+
+    // 每个客户端各写自己的一段，结束后合并排序
+    std::vector<std::vector<double>> latency(connections);
+    sem_t done;
+    sem_init(&done, 0, 0);
+    std::atomic<size_t> completed{0};
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < connections;i++)
+    {
+	iom.schedulerLock([&iom, &done, &completed, samples = &latency[i], addr, requests, size]()
+	{
+	    int fd = tcpSocket();
+	    if(iom.asyncConnect(fd, (const sockaddr*)&addr, sizeof(addr)))
+	    {
+		perror("connect");
+		exit(1);
+	    }
+	    std::vector<char> request(size, 'x'), response(size);
+	    samples->reserve(requests);
+	    for(size_t r = 0;r < requests;r++)
+	    {
+		auto begin = std::chrono::steady_clock::now();
+		if(!writeFull(iom, fd, request.data(), size) || !readFull(iom, fd, response.data(), size))
+		{
+		    break;
+		}
+		samples->push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+		completed.fetch_add(1, std::memory_order_relaxed);
+	    }
+	    iom.cancelAll(fd);
+	    close(fd);
+	    sem_post(&done);
+	});
+    }
+    for(size_t i = 0;i < connections;i++)
+    {
+	sem_wait(&done);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sem_destroy(&done);
+    if(completed != connections * requests)
+    {
+	fprintf(stderr, "echo: %zu of %zu requests completed\n", completed.load(), connections * requests);
+	exit(1);
+    }
+    std::vector<double> all;
+    all.reserve(completed);
+    for(auto& samples : latency)
+    {
+	all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+    double rps = completed / seconds, p50 = all[all.size() / 2], p99 = all[all.size() * 99 / 100];
+    printf("%-8s %-8zu %12.0f %10.1f %10.1f\n", backend, threads, rps, p50, p99);
+    fflush(stdout);
+    std::string name = std::string(backend) + "/threads=" + std::to_string(threads);
+    report.add(name, "throughput", rps, "req/s");
+    report.add(name, "p50_latency", p50, "us");
+    report.add(name, "p99_latency", p99, "us");
+    iom.stop();
+    close(listen_fd);
+}
+
+int main(int argc, char** argv)
+{
+    size_t connections = argc > 1 ? strtoull(argv[1], nullptr, 10) : 64;
+    size_t requests = argc > 2 ? strtoull(argv[2], nullptr, 10) : 2000;
+    size_t size = argc > 3 ? strtoull(argv[3], nullptr, 10) : 64;
+    printf("connections=%zu requests=%zu size=%zu\n", connections, requests, size);
+    printf("%-8s %-8s %12s %10s %10s\n", "backend", "threads", "req/s", "p50(us)", "p99(us)");
+    BenchReport report("echo");
+    const size_t threads[] = {1, 2, 4};
+    for(size_t t : threads)
+    {
+	run(report, "epoll", IOManager::EPOLL, t, connections, requests, size);
+    }
+    for(size_t t : threads)
+    {
+	run(report, "uring", IOManager::IO_URING, t, connections, requests, size);
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ - File Name: epoll_registration_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sun 25 Oct 2026 04:20:13 PM CST
+ */
+
+// 每次IO等待的epoll_ctl次数：pairs对socketpair上的协程互相收发rounds轮，
+// 每轮双方各等待一次可读．oneshot为默认的注册方式，persistent为setPersistentEvents(true)
+// ctl/wait: 平均每次等待的epoll_ctl次数
+#include "ioscheduler.h"
+#include "bench_report.h"
+#include <sys/socket.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <semaphore.h>
+
+using namespace Hourglass;
+
+static void run(BenchReport& report, bool persistent, size_t pairs, size_t rounds)
+{
+    IOManager iom(2, true, "registration");
+    iom.setPersistentEvents(persistent);
+    sem_t done;
+    sem_init(&done, 0, 0);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < pairs;i++)
+    {
+	int fds[2];
+	if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds))
+	{
+	    perror("socketpair");
+	    exit(1);
+	}
+	// 0端先发，1端回显
+	for(int side = 0;side < 2;side++)
+	{
+	    iom.schedulerLock([&iom, &done, fds, side, rounds]()
+	    {
+		int fd = fds[side];
+		char c = 'x';
+		for(size_t r = 0;r < rounds;r++)
+		{
+		    if(side == 0 && iom.asyncWrite(fd, &c, 1) != 1)
+		    {
+			break;
+		    }
+		    if(iom.asyncRead(fd, &c, 1) != 1)
+		    {
+			break;
+		    }
+		    if(side == 1 && iom.asyncWrite(fd, &c, 1) != 1)
+		    {
+			break;
+		    }
+		}
+		iom.cancelAll(fd);
+		close(fd);
+		sem_post(&done);
+	    });
+	}
+    }
+    for(size_t i = 0;i < pairs * 2;i++)
+    {
+	sem_wait(&done);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sem_destroy(&done);
+    double waits = (double)pairs * rounds * 2;
+    const char* mode = persistent ? "persistent" : "oneshot";
+    double ctl = iom.getEpollCtlCalls() / waits, wakeups = iom.getWakeupSyscalls() / waits;
+    printf("%-12s %12.0f %10.3f %10.3f\n", mode, waits / seconds, ctl, wakeups);
+    report.add(mode, "throughput", waits / seconds, "wait/s");
+    report.add(mode, "epoll_ctl", ctl, "call/wait");
+    report.add(mode, "wakeups", wakeups, "syscall/wait");
+    fflush(stdout);
+    iom.stop();
+}
+
+int main(int argc, char** argv)
+{
+    size_t pairs = argc > 1 ? strtoull(argv[1], nullptr, 10) : 64;
+    size_t rounds = argc > 2 ? strtoull(argv[2], nullptr, 10) : 2000;
+    printf("%-12s %12s %10s %10s\n", "mode", "wait/s", "ctl/wait", "wake/wait");
+    BenchReport report("epoll_registration");
+    run(report, false, pairs, rounds);
+    run(report, true, pairs, rounds);
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ - File Name: io_timeout_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Fri 30 Oct 2026 11:26:05 AM CST
+ */
+
+// 带超时的IO等待的开销：pairs对socketpair上的协程互相收发rounds轮，每次等待可读都带1s的超时（不会触发）
+// timer:    addConditionTimer + weak_ptr哨兵，超时时cancelEvent（hook原来的做法）
+// deadline: waitEvent(fd, READ, deadline)，截止时间记在fd的事件上下文中
+#include "ioscheduler.h"
+#include "bench_report.h"
+#include <sys/socket.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <semaphore.h>
+
+using namespace Hourglass;
+
+static const uint64_t TIMEOUT_MS = 1000;
+
+struct TimerInfo
+{
+    int cancelled = 0;
+};
+
+// 返回0为就绪，-1为超时
+static int waitWithTimer(IOManager& iom, int fd)
+{
+    std::shared_ptr<TimerInfo> tinfo(new TimerInfo);
+    std::weak_ptr<TimerInfo> winfo(tinfo);
+    std::shared_ptr<Timer> timer = iom.addConditionTimer(TIMEOUT_MS, [winfo, fd, &iom]()
+    {
+	auto t = winfo.lock();
+	if(!t || t->cancelled)
+	{
+	    return;
+	}
+	t->cancelled = 1;
+	iom.cancelEvent(fd, IOManager::READ);
+    }, winfo);
+    if(iom.addEvent(fd, IOManager::READ) == 0)
+    {
+	Coroutine::getCoroutine()->yield();
+    }
+    timer->cancel();
+    return tinfo->cancelled ? -1 : 0;
+}
+
+static int waitWithDeadline(IOManager& iom, int fd)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+    return iom.waitEvent(fd, IOManager::READ, deadline) == IOManager::EVENT_READY ? 0 : -1;
+}
+
+// 非阻塞读，没有数据时等待
+static bool readOne(IOManager& iom, int fd, bool deadline)
+{
+    char c;
+    while(read(fd, &c, 1) != 1)
+    {
+	if(errno != EAGAIN)
+	{
+	    return false;
+	}
+	if((deadline ? waitWithDeadline(iom, fd) : waitWithTimer(iom, fd)) != 0)
+	{
+	    return false;
+	}
+    }
+    return true;
+}
+
+static void run(BenchReport& report, bool deadline, size_t pairs, size_t rounds)
+{
+    IOManager iom(2, true, "timeout");
+    sem_t done;
+    sem_init(&done, 0, 0);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < pairs;i++)
+    {
+	int fds[2];
+	if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds))
+	{
+	    perror("socketpair");
+	    exit(1);
+	}
+	for(int side = 0;side < 2;side++)
+	{
+	    iom.schedulerLock([&iom, &done, fds, side, rounds, deadline]()
+	    {
+		int fd = fds[side];
+		char c = 'x';
+		for(size_t r = 0;r < rounds;r++)
+		{
+		    if(side == 0 && write(fd, &c, 1) != 1)
+		    {
+			break;
+		    }
+		    if(!readOne(iom, fd, deadline))
+		    {
+			break;
+		    }
+		    if(side == 1 && write(fd, &c, 1) != 1)
+		    {
+			break;
+		    }
+		}
+		iom.cancelAll(fd);
+		close(fd);
+		sem_post(&done);
+	    });
+	}
+    }
+    for(size_t i = 0;i < pairs * 2;i++)
+    {
+	sem_wait(&done);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sem_destroy(&done);
+    const char* mode = deadline ? "deadline" : "timer";
+    printf("%-10s %12.0f\n", mode, pairs * rounds * 2 / seconds);
+    report.add(mode, "throughput", pairs * rounds * 2 / seconds, "wait/s");
+    fflush(stdout);
+    iom.stop();
+}
+
+int main(int argc, char** argv)
+{
+    size_t pairs = argc > 1 ? strtoull(argv[1], nullptr, 10) : 64;
+    size_t rounds = argc > 2 ? strtoull(argv[2], nullptr, 10) : 2000;
+    printf("%-10s %12s\n", "mode", "wait/s");
+    BenchReport report("io_timeout");
+    run(report, false, pairs, rounds);
+    run(report, true, pairs, rounds);
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ - File Name: priority_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Thu 29 Oct 2026 05:02:18 PM CST
+ */
+
+// 优先级对排队时延的影响：每个工作线程上有若干条后台任务链（每个任务忙work_us微秒后重新提交自己），
+// 调用线程每隔1ms提交一个很短的前台任务，统计前台任务从提交到开始执行的时延
+// fifo:     前台任务也是NORMAL
+// high:     前台任务为HIGH
+// reserved: 前台任务为HIGH，并为它保留一个运行任务的线程
+// bg/s: 后台任务的吞吐，时延为所在桶的上界（微秒）
+#include "ioscheduler.h"
+#include "bench_report.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace Hourglass;
+
+static void busy(size_t us)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    while(std::chrono::steady_clock::now() < end);
+}
+
+static void run(BenchReport& report, const char* mode, size_t threads, size_t samples, size_t work_us)
+{
+    IOManager iom(threads + 1, true, "priority");
+    bool high = mode[0] != 'f';
+    if(mode[0] == 'r')
+    {
+	// 调用线程在stop之前不运行任务，但也算一个工作线程，所以多保留一个
+	iom.setReservedWorkers(2);
+    }
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> background{0};
+    std::function<void()> chain = [&]()
+    {
+	busy(work_us);
+	background.fetch_add(1,std::memory_order_relaxed);
+	if(!stop.load(std::memory_order_relaxed))
+	{
+	    iom.schedulerLock(chain);
+	}
+    };
+    for(size_t i = 0;i < threads * 4;i++)
+    {
+	iom.schedulerLock(chain);
+    }
+    LatencyHistogram latency;
+    std::atomic<size_t> done{0};
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < samples;i++)
+    {
+	auto submit = std::chrono::steady_clock::now();
+	auto task = [&latency, &done, submit]()
+	{
+	    latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - submit).count());
+	    done++;
+	};
+	if(high)
+	{
+	    iom.schedulerPriority(task, Scheduler::HIGH);
+	}
+	else
+	{
+	    iom.schedulerLock(task);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    while(done < samples)
+    {
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stop = true;
+    double p50 = latency.percentile(50) / 1e3, p99 = latency.percentile(99) / 1e3, p999 = latency.percentile(99.9) / 1e3;
+    printf("%-10s %-8zu %12.0f %10.1f %10.1f %10.1f\n", mode, threads, background.load() / seconds, p50, p99, p999);
+    std::string name = std::string(mode) + "/threads=" + std::to_string(threads);
+    report.add(name, "background", background.load() / seconds, "task/s");
+    report.add(name, "p50_delay", p50, "us");
+    report.add(name, "p99_delay", p99, "us");
+    report.add(name, "p999_delay", p999, "us");
+    fflush(stdout);
+    iom.stop();
+}
+
+int main(int argc, char** argv)
+{
+    size_t samples = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000;
+    size_t work_us = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100;
+    BenchReport report("priority");
+    printf("%-10s %-8s %12s %10s %10s %10s\n", "mode", "threads", "bg/s", "p50(us)", "p99(us)", "p999(us)");
+    const size_t threads[] = {2, 4};
+    for(size_t t : threads)
+    {
+	run(report, "fifo", t, samples, work_us);
+	run(report, "high", t, samples, work_us);
+	run(report, "reserved", t, samples, work_us);
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ - File Name: scheduler_scaling_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Sun 18 Oct 2026 03:15:48 PM CST
+ */
+
+// 调度吞吐随线程数的变化
+// external: 调用线程提交全部任务，走全局注入队列
+// fanout:   每个工作线程上的种子任务各自提交一批任务，走本地队列与窃取
+// wake/task: 平均每个任务花费的唤醒系统调用数
+#include "ioscheduler.h"
+#include "bench_report.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace Hourglass;
+
+// 只统计到最后一个任务完成为止，不包含线程退出的时间
+struct Counter
+{
+    std::atomic<size_t> done{0};
+    size_t total = 0;
+    std::chrono::steady_clock::time_point end;
+    void hit()
+    {
+	if(done.fetch_add(1,std::memory_order_relaxed) + 1 == total)
+	{
+	    end = std::chrono::steady_clock::now();
+	}
+    }
+};
+
+static double runExternal(size_t threads, size_t tasks, double* wakeups)
+{
+    Counter counter;
+    counter.total = tasks;
+    IOManager iom(threads, true, "bench");
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < tasks;i++)
+    {
+	iom.schedulerLock([&counter](){counter.hit();});
+    }
+    iom.stop();
+    *wakeups = iom.getWakeupSyscallsPerTask();
+    return tasks / std::chrono::duration<double>(counter.end - start).count();
+}
+
+static double runFanout(size_t threads, size_t tasks, double* wakeups)
+{
+    size_t seeds = threads * 4;
+    Counter counter;
+    counter.total = tasks / seeds * seeds;
+    IOManager iom(threads, true, "bench");
+    auto start = std::chrono::steady_clock::now();
+    for(size_t s = 0;s < seeds;s++)
+    {
+	iom.schedulerLock([&counter, tasks, seeds]()
+	{
+	    Scheduler* sc = Scheduler::GetThis();
+	    for(size_t i = 0;i < tasks / seeds;i++)
+	    {
+		sc->schedulerLock([&counter](){counter.hit();});
+	    }
+	});
+    }
+    iom.stop();
+    *wakeups = iom.getWakeupSyscallsPerTask();
+    return counter.total / std::chrono::duration<double>(counter.end - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    size_t tasks = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t max_threads = argc > 2 ? strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    BenchReport report("scheduler_scaling");
+    printf("%-8s %16s %10s %16s %10s\n", "threads", "external task/s", "wake/task", "fanout task/s", "wake/task");
+    for(size_t t = 1;t <= max_threads;t *= 2)
+    {
+	double external_wakeups = 0, fanout_wakeups = 0;
+	double external = runExternal(t, tasks, &external_wakeups);
+	double fanout = runFanout(t, tasks, &fanout_wakeups);
+	printf("%-8zu %16.0f %10.3f %16.0f %10.3f\n", t, external, external_wakeups, fanout, fanout_wakeups);
+	std::string threads = "/threads=" + std::to_string(t);
+	report.add("external" + threads, "throughput", external, "task/s");
+	report.add("external" + threads, "wakeups", external_wakeups, "syscall/task");
+	report.add("fanout" + threads, "throughput", fanout, "task/s");
+	report.add("fanout" + threads, "wakeups", fanout_wakeups, "syscall/task");
+	fflush(stdout);
+    }
+    return 0;
+}
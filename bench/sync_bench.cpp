@@ -0,0 +1,149 @@
+/*
+ - File Name: sync_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Tue 27 Oct 2026 09:47:26 AM CST
+ */
+
+// 协程同步原语与std对应物在竞争下的对比
+// mutex:    coroutines个协程各自加锁递增计数器iterations次
+// condvar:  两个协程通过条件变量轮流翻转一个标志（std版本每个等待的协程占住一个线程）
+// semaphore:两个协程各等自己的信号量、释放对方的信号量（std版本使用Threadsem）
+// threads为测量期间运行任务的线程数，调用线程只在结束时参与调度
+#include "ioscheduler.h"
+#include "sync.h"
+#include "bench_report.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Hourglass;
+
+template <class MutexType>
+static double mutexBench(size_t threads, size_t coroutines, size_t iterations)
+{
+    IOManager iom(threads + 1, true, "sync");
+    MutexType mutex;
+    volatile uint64_t counter = 0;
+    WaitGroup wg;
+    wg.add(coroutines);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < coroutines;i++)
+    {
+	iom.schedulerLock([&]()
+	{
+	    for(size_t k = 0;k < iterations;k++)
+	    {
+		std::lock_guard<MutexType> lock(mutex);
+		counter = counter + 1;
+	    }
+	    wg.done();
+	});
+    }
+    wg.wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    iom.stop();
+    if(counter != coroutines * iterations)
+    {
+	fprintf(stderr, "mutex: lost updates\n");
+	exit(1);
+    }
+    return coroutines * iterations / seconds;
+}
+
+template <class MutexType, class CondType>
+static double condBench(size_t rounds)
+{
+    IOManager iom(3, true, "sync");
+    MutexType mutex;
+    CondType cond;
+    bool turn = false;
+    WaitGroup wg;
+    wg.add(2);
+    auto start = std::chrono::steady_clock::now();
+    for(int side = 0;side < 2;side++)
+    {
+	iom.schedulerLock([&, side]()
+	{
+	    for(size_t r = 0;r < rounds;r++)
+	    {
+		std::unique_lock<MutexType> lock(mutex);
+		cond.wait(lock, [&](){return turn == (side == 1);});
+		turn = !turn;
+		cond.notify_one();
+	    }
+	    wg.done();
+	});
+    }
+    wg.wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    iom.stop();
+    return rounds * 2 / seconds;
+}
+
+// 统一Semaphore与Threadsem的接口
+struct CoSem
+{
+    Semaphore sem;
+    void wait() {sem.acquire();}
+    void signal() {sem.release();}
+};
+
+template <class SemType>
+static double semBench(size_t rounds)
+{
+    IOManager iom(3, true, "sync");
+    SemType sems[2];
+    WaitGroup wg;
+    wg.add(2);
+    auto start = std::chrono::steady_clock::now();
+    for(int side = 0;side < 2;side++)
+    {
+	iom.schedulerLock([&, side]()
+	{
+	    for(size_t r = 0;r < rounds;r++)
+	    {
+		if(side == 0)
+		{
+		    sems[1].signal();
+		    sems[0].wait();
+		}
+		else
+		{
+		    sems[1].wait();
+		    sems[0].signal();
+		}
+	    }
+	    wg.done();
+	});
+    }
+    wg.wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    iom.stop();
+    return rounds * 2 / seconds;
+}
+
+static void row(BenchReport& report, const char* primitive, size_t threads, size_t coroutines, double hourglass, double std)
+{
+    printf("%-10s %-8zu %-11zu %14.0f %14.0f\n", primitive, threads, coroutines, hourglass, std);
+    fflush(stdout);
+    std::string name = std::string(primitive) + "/threads=" + std::to_string(threads);
+    report.add(name + "/hourglass", "throughput", hourglass, "op/s");
+    report.add(name + "/std", "throughput", std, "op/s");
+}
+
+int main(int argc, char** argv)
+{
+    size_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000;
+    size_t rounds = argc > 2 ? strtoull(argv[2], nullptr, 10) : 50000;
+    BenchReport report("sync");
+    printf("%-10s %-8s %-11s %14s %14s\n", "primitive", "threads", "coroutines", "hourglass/s", "std/s");
+    const size_t threads[] = {1, 2, 4};
+    for(size_t t : threads)
+    {
+	row(report, "mutex", t, 64, mutexBench<Mutex>(t, 64, iterations), mutexBench<std::mutex>(t, 64, iterations));
+    }
+    row(report, "condvar", 2, 2, condBench<Mutex, ConditionVariable>(rounds), condBench<std::mutex, std::condition_variable>(rounds));
+    row(report, "semaphore", 2, 2, semBench<CoSem>(rounds), semBench<Threadsem>(rounds));
+    return 0;
+}
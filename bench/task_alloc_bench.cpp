@@ -0,0 +1,158 @@
+/*
+ - File Name: task_alloc_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Mon 02 Nov 2026 02:37:12 PM CST
+ */
+
+// 每个任务的堆分配次数与吞吐：替换全局operator new计数，先预热让协程池、任务空闲链表和队列长到稳定大小，
+// 再统计提交到全部执行完之间的分配次数
+// capture=N: 捕获N字节的lambda，不超过InlineFunction::INLINE_SIZE时应为0次，超过时为1次
+// std::function: 先包成std::function再提交，捕获超过16字节时std::function自己要分配一次
+// external: 调用线程提交，走全局注入队列；fanout: 工作线程上的种子任务提交，走本地队列
+// 任务数要小于全局任务池保留的上限（64K个），积压超过上限时多出来的任务对象每轮都会重新分配
+#include "ioscheduler.h"
+#include "bench_report.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <thread>
+
+static std::atomic<size_t> s_allocations{0};
+
+void* operator new(size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if(!p)
+    {
+	throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+using namespace Hourglass;
+
+struct Counter
+{
+    std::atomic<size_t> done{0};
+};
+
+// 捕获&counter和N-8字节的数据，整个lambda为N字节
+template <size_t N>
+struct Capture
+{
+    Counter* counter;
+    char data[N - sizeof(Counter*)];
+    void operator()() const
+    {
+	counter->done.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+template <size_t N>
+static void submit(Scheduler* sc, Counter& counter, bool wrap)
+{
+    Capture<N> capture;
+    capture.counter = &counter;
+    if(wrap)
+    {
+	sc->schedulerLock(std::function<void()>(capture));
+    }
+    else
+    {
+	sc->schedulerLock(capture);
+    }
+}
+
+static void wait(Counter& counter, size_t total)
+{
+    while(counter.done.load(std::memory_order_relaxed) < total)
+    {
+	std::this_thread::yield();
+    }
+}
+
+template <size_t N>
+static void runOnce(IOManager& iom, bool fanout, bool wrap, size_t tasks)
+{
+    Counter counter;
+    if(!fanout)
+    {
+	for(size_t i = 0;i < tasks;i++)
+	{
+	    submit<N>(&iom, counter, wrap);
+	}
+	wait(counter, tasks);
+	return;
+    }
+    const size_t seeds = 16;
+    Counter seeded;
+    for(size_t s = 0;s < seeds;s++)
+    {
+	iom.schedulerLock([&counter, &seeded, wrap, tasks]()
+	{
+	    Scheduler* sc = Scheduler::GetThis();
+	    for(size_t i = 0;i < tasks / seeds;i++)
+	    {
+		submit<N>(sc, counter, wrap);
+	    }
+	    seeded.done.fetch_add(1, std::memory_order_relaxed);
+	});
+    }
+    wait(seeded, seeds);
+    wait(counter, tasks / seeds * seeds);
+}
+
+template <size_t N>
+static void run(BenchReport& report, const char* name, size_t threads, bool fanout, bool wrap, size_t tasks)
+{
+    IOManager iom(threads, false, "bench");
+    // 外部提交时积压的峰值每轮都可能更高，多预热几轮让任务空闲链表里的节点数稳定下来
+    for(int i = 0;i < 3;i++)
+    {
+	runOnce<N>(iom, fanout, wrap, tasks);
+    }
+    size_t before = s_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    runOnce<N>(iom, fanout, wrap, tasks);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double per_task = double(s_allocations.load() - before) / tasks;
+    iom.stop();
+    const char* mode = fanout ? "fanout" : "external";
+    printf("%-16s %-10s %12.3f %14.0f\n", name, mode, per_task, tasks / seconds);
+    fflush(stdout);
+    std::string key = std::string(name) + "/" + mode;
+    report.add(key, "allocations", per_task, "alloc/task");
+    report.add(key, "throughput", tasks / seconds, "task/s");
+}
+
+int main(int argc, char** argv)
+{
+    size_t tasks = argc > 1 ? strtoull(argv[1], nullptr, 10) : 50000;
+    size_t threads = argc > 2 ? strtoull(argv[2], nullptr, 10) : 2;
+    BenchReport report("task_alloc");
+    printf("threads=%zu tasks=%zu inline=%zu bytes\n", threads, tasks, InlineFunction::INLINE_SIZE);
+    printf("%-16s %-10s %12s %14s\n", "task", "submit", "alloc/task", "task/s");
+    for(bool fanout : {false, true})
+    {
+	run<16>(report, "capture=16", threads, fanout, false, tasks);
+	run<96>(report, "capture=96", threads, fanout, false, tasks);
+	run<256>(report, "capture=256", threads, fanout, false, tasks);
+	run<96>(report, "std::function/96", threads, fanout, true, tasks);
+    }
+    return 0;
+}
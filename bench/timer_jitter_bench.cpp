@@ -0,0 +1,73 @@
+/*
+ - File Name: timer_jitter_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Tue 20 Oct 2026 10:05:42 AM CST
+ */
+
+// 定时器触发抖动：依次设置一个定时器，记录实际触发时间比到期时间晚了多少
+// 每个间隔测量samples次，输出p50/p99/max（微秒）
+#include "ioscheduler.h"
+#include "bench_report.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <semaphore.h>
+
+using namespace Hourglass;
+
+static void measure(BenchReport& report, IOManager& iom, std::chrono::nanoseconds interval, size_t samples, const char* name)
+{
+    std::vector<double> late;
+    late.reserve(samples);
+    sem_t done;
+    sem_init(&done, 0, 0);
+    for(size_t i = 0;i < samples;i++)
+    {
+	auto deadline = std::chrono::steady_clock::now() + interval;
+	iom.addTimer(interval, [&late, &done, deadline]()
+	{
+	    late.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - deadline).count());
+	    sem_post(&done);
+	});
+	sem_wait(&done);
+    }
+    sem_destroy(&done);
+    std::sort(late.begin(), late.end());
+    double p50 = late[late.size() / 2], p99 = late[late.size() * 99 / 100];
+    printf("%-8s %10.0f %10.1f %10.1f %10.1f\n", name, interval.count() / 1000.0, p50, p99, late.back());
+    std::string label = std::string(name) + "/interval_us=" + std::to_string(interval.count() / 1000);
+    report.add(label, "p50_late", p50, "us");
+    report.add(label, "p99_late", p99, "us");
+    report.add(label, "max_late", late.back(), "us");
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    size_t samples = argc > 1 ? strtoull(argv[1], nullptr, 10) : 500;
+    BenchReport report("timer_jitter");
+    printf("%-8s %10s %10s %10s %10s\n", "backend", "interval", "p50 late", "p99 late", "max late");
+    const std::chrono::nanoseconds intervals[] = {
+	std::chrono::microseconds(100), std::chrono::microseconds(250), std::chrono::microseconds(500),
+	std::chrono::milliseconds(1), std::chrono::milliseconds(5)};
+    {
+	IOManager iom(2, true, "jitter", TimerManager::SET);
+	for(auto interval : intervals)
+	{
+	    measure(report, iom, interval, samples, "set");
+	}
+	iom.stop();
+    }
+    {
+	// 时间轮的精度是1ms，到期时间向上取整到tick
+	IOManager iom(2, true, "jitter", TimerManager::WHEEL);
+	for(auto interval : intervals)
+	{
+	    measure(report, iom, interval, samples, "wheel");
+	}
+	iom.stop();
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ - File Name: timer_wheel_bench.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Mon 19 Oct 2026 04:20:11 PM CST
+ */
+
+// 大量连接空闲超时定时器的场景：先加入N个定时器，然后随机刷新、最后全部取消
+// 分别统计SET与WHEEL两种后端每种操作的吞吐
+#include "timer.h"
+#include "bench_report.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace Hourglass;
+
+struct Result
+{
+    double add;
+    double refresh;
+    double cancel;
+};
+
+static double rate(size_t ops, std::chrono::steady_clock::time_point start)
+{
+    return ops / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void print(BenchReport& report, const char* backend, const Result& result)
+{
+    printf("%-8s %14.0f %14.0f %14.0f\n", backend, result.add, result.refresh, result.cancel);
+    report.add(backend, "add", result.add, "op/s");
+    report.add(backend, "refresh", result.refresh, "op/s");
+    report.add(backend, "cancel", result.cancel, "op/s");
+}
+
+static Result run(TimerManager::Backend backend, size_t timers, size_t refreshes, uint64_t timeout_ms)
+{
+    Result result;
+    TimerManager manager(backend);
+    std::vector<std::shared_ptr<Timer>> handles;
+    handles.reserve(timers);
+    std::mt19937_64 rng(42);
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < timers;i++)
+    {
+	// 超时时间稍有差别，避免全部落在同一个位置
+	handles.push_back(manager.addTimer(timeout_ms + rng() % 1000, [](){}));
+    }
+    result.add = rate(timers, start);
+
+    std::vector<std::function<void()>> expired;
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0;i < refreshes;i++)
+    {
+	handles[rng() % timers]->refresh();
+	// 模拟poller周期性地检查到期定时器
+	if(i % 4096 == 0)
+	{
+	    manager.getNextTimer();
+	    manager.listExpiredFunc(expired);
+	}
+    }
+    result.refresh = rate(refreshes, start);
+
+    start = std::chrono::steady_clock::now();
+    for(auto& timer : handles)
+    {
+	timer->cancel();
+    }
+    result.cancel = rate(timers, start);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    size_t timers = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+    size_t refreshes = argc > 2 ? strtoull(argv[2], nullptr, 10) : 2000000;
+    uint64_t timeout_ms = argc > 3 ? strtoull(argv[3], nullptr, 10) : 30000;
+    printf("timers=%zu refreshes=%zu timeout=%llums\n", timers, refreshes, (unsigned long long)timeout_ms);
+    printf("%-8s %14s %14s %14s\n", "backend", "add/s", "refresh/s", "cancel/s");
+    BenchReport report("timer_wheel");
+    print(report, "set", run(TimerManager::SET, timers, refreshes, timeout_ms));
+    print(report, "wheel", run(TimerManager::WHEEL, timers, refreshes, timeout_ms));
+    return 0;
+}
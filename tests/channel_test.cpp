@@ -0,0 +1,311 @@
+/*
+ - File Name: channel_test.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Thu 05 Nov 2026 09:42:17 AM CST
+ */
+
+// 通道：多生产者多消费者下每个值恰好收到一次；Select的超时与多通道混合；
+// 关闭时挂起的发送方和接收方都要返回；无缓冲通道上trySend只交给挂起的接收方
+#include "ioscheduler.h"
+#include "channel.h"
+#include "test_util.h"
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace Hourglass;
+
+static const int PRODUCERS = 4;
+static const int CONSUMERS = 4;
+static const int PER_PRODUCER = 2000;
+
+// 只能移动的值，每个值都要被恰好一个消费者收到
+static void mpmcStress(size_t capacity)
+{
+    Channel<std::unique_ptr<int>> ch(capacity);
+    std::vector<std::atomic<int>> seen(PRODUCERS * PER_PRODUCER);
+    std::atomic<int> producers_done{0}, consumers_done{0}, received{0};
+    IOManager iom(4, false, "channel_test");
+    for(int c = 0;c < CONSUMERS;c++)
+    {
+	iom.schedulerLock([&]()
+	{
+	    std::unique_ptr<int> value;
+	    while(ch.recv(value))
+	    {
+		CHECK(value);
+		seen[*value]++;
+		received++;
+	    }
+	    consumers_done++;
+	});
+    }
+    for(int p = 0;p < PRODUCERS;p++)
+    {
+	iom.schedulerLock([&, p]()
+	{
+	    for(int i = 0;i < PER_PRODUCER;i++)
+	    {
+		CHECK(ch.send(std::unique_ptr<int>(new int(p * PER_PRODUCER + i))));
+	    }
+	    if(++producers_done == PRODUCERS)
+	    {
+		ch.close();
+	    }
+	});
+    }
+    CHECK(waitUntil([&](){return consumers_done == CONSUMERS;}));
+    iom.stop();
+    CHECK(received == PRODUCERS * PER_PRODUCER);
+    for(auto& count : seen)
+    {
+	CHECK(count == 1);
+    }
+    CHECK(ch.size() == 0);
+    std::unique_ptr<int> value;
+    CHECK(!ch.send(std::unique_ptr<int>(new int(0))));
+    CHECK(!ch.tryRecv(value));
+}
+
+// 没有分支可以完成时按超时返回-1，超时之前送到的值要被选中
+static void selectTimeout()
+{
+    Channel<int> ch(1);
+    std::atomic<bool> finished{false};
+    IOManager iom(2, false, "channel_test");
+    iom.schedulerLock([&]()
+    {
+	int value = 0;
+	bool ok = false;
+	Select empty;
+	empty.recv(ch, &value, &ok);
+	CHECK(empty.tryOnce() == -1);
+	auto start = std::chrono::steady_clock::now();
+	CHECK(empty.wait(std::chrono::milliseconds(5)) == -1);
+	CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(5));
+	CHECK(!ok);
+
+	IOManager::GetIOManager()->addTimer(std::chrono::milliseconds(2), [&ch](){CHECK(ch.trySend(7));});
+	Select later;
+	later.recv(ch, &value, &ok);
+	CHECK(later.wait(std::chrono::seconds(5)) == 0);
+	CHECK(ok && value == 7);
+	finished = true;
+    });
+    CHECK(waitUntil([&](){return finished.load();}));
+    iom.stop();
+}
+
+// 满的通道上挂起的发送方、空的通道上挂起的接收方在close之后都返回false；
+// 关闭之前已经放入的值仍然可以取到
+static void closeWhileParked(size_t capacity)
+{
+    const int WAITERS = 4;
+    Channel<int> full(capacity);
+    Channel<int> empty(capacity);
+    std::atomic<int> started{0}, sent{0}, failed_sends{0}, failed_recvs{0};
+    for(size_t i = 0;i < capacity;i++)
+    {
+	CHECK(full.trySend(-1));
+    }
+    IOManager iom(2, false, "channel_test");
+    // 无缓冲通道上第一个发送方放入值之后等接收方，其余的等空位
+    for(int i = 0;i < WAITERS;i++)
+    {
+	iom.schedulerLock([&, i]()
+	{
+	    started++;
+	    if(full.send(i))
+	    {
+		sent++;
+	    }
+	    else
+	    {
+		failed_sends++;
+	    }
+	});
+	iom.schedulerLock([&]()
+	{
+	    started++;
+	    int value;
+	    if(!empty.recv(value))
+	    {
+		failed_recvs++;
+	    }
+	});
+    }
+    CHECK(waitUntil([&](){return started == 2 * WAITERS;}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(sent == 0 && failed_sends == 0 && failed_recvs == 0);
+    full.close();
+    empty.close();
+    CHECK(waitUntil([&](){return sent + failed_sends == WAITERS && failed_recvs == WAITERS;}));
+    iom.stop();
+    // 有缓冲时发送方都没有放入；无缓冲时只有已经放入值的那一个返回true
+    CHECK(sent == (capacity ? 0 : 1));
+    int value;
+    size_t left = 0;
+    while(full.recv(value))
+    {
+	left++;
+    }
+    CHECK(left == (capacity ? capacity : 1));
+    CHECK(!empty.recv(value));
+}
+
+// 无缓冲通道：没有挂起的接收方时trySend失败且不移走值，有接收方挂起时交给它
+static void unbufferedTrySend()
+{
+    Channel<std::unique_ptr<int>> ch(0);
+    std::unique_ptr<int> value(new int(42));
+    CHECK(!ch.trySend(std::move(value)));
+    CHECK(value && *value == 42);
+    CHECK(ch.size() == 0);
+
+    std::atomic<int> got{0};
+    IOManager iom(2, false, "channel_test");
+    iom.schedulerLock([&]()
+    {
+	std::unique_ptr<int> out;
+	CHECK(ch.recv(out));
+	got = *out;
+    });
+    CHECK(waitUntil([&](){return ch.trySend(std::move(value));}));
+    CHECK(!value);
+    CHECK(waitUntil([&](){return got == 42;}));
+    iom.stop();
+    CHECK(ch.size() == 0);
+
+    // 挂起的Select不会被接收方唤醒，无缓冲通道上的发送分支直接报错
+    bool thrown = false;
+    try
+    {
+	Select sel;
+	sel.send(ch, std::unique_ptr<int>(new int(1)));
+    }
+    catch(const std::logic_error&)
+    {
+	thrown = true;
+    }
+    CHECK(thrown);
+}
+
+// 一个协程用Select同时从无缓冲通道、有缓冲通道接收并向另一个通道发送，所有值都要恰好经过一次
+static void selectMixed()
+{
+    const int COUNT = 1000;
+    Channel<int> numbers(0);
+    Channel<std::string> words(4);
+    Channel<int> out(1);
+    std::atomic<int> numbers_got{0}, words_got{0}, out_got{0}, finished{0};
+    std::atomic<long> number_sum{0}, out_sum{0};
+    IOManager iom(4, false, "channel_test");
+    iom.schedulerLock([&]()
+    {
+	for(int i = 1;i <= COUNT;i++)
+	{
+	    CHECK(numbers.send(i));
+	}
+	numbers.close();
+	finished++;
+    });
+    iom.schedulerLock([&]()
+    {
+	for(int i = 0;i < COUNT;i++)
+	{
+	    CHECK(words.send(std::to_string(i)));
+	}
+	words.close();
+	finished++;
+    });
+    iom.schedulerLock([&]()
+    {
+	int value;
+	while(out.recv(value))
+	{
+	    out_got++;
+	    out_sum += value;
+	}
+	finished++;
+    });
+    iom.schedulerLock([&]()
+    {
+	int next = 1;
+	bool numbers_open = true, words_open = true;
+	while(numbers_open || words_open || next <= COUNT)
+	{
+	    int number = 0;
+	    std::string word;
+	    bool number_ok = false, word_ok = false, out_ok = false;
+	    // 各分支的下标按添加顺序
+	    int number_case = -1, word_case = -1, out_case = -1, cases = 0;
+	    Select sel;
+	    if(numbers_open)
+	    {
+		sel.recv(numbers, &number, &number_ok);
+		number_case = cases++;
+	    }
+	    if(words_open)
+	    {
+		sel.recv(words, &word, &word_ok);
+		word_case = cases++;
+	    }
+	    if(next <= COUNT)
+	    {
+		sel.send(out, next, &out_ok);
+		out_case = cases++;
+	    }
+	    int index = sel.wait(std::chrono::seconds(10));
+	    CHECK(index >= 0);
+	    // 被选中而没有成功的只能是已经关闭且取完的接收分支
+	    if(index == number_case)
+	    {
+		numbers_open = number_ok;
+		if(number_ok)
+		{
+		    numbers_got++;
+		    number_sum += number;
+		}
+	    }
+	    else if(index == word_case)
+	    {
+		words_open = word_ok;
+		if(word_ok)
+		{
+		    CHECK(std::stoi(word) == words_got);
+		    words_got++;
+		}
+	    }
+	    else
+	    {
+		CHECK(index == out_case && out_ok);
+		next++;
+	    }
+	}
+	out.close();
+	finished++;
+    });
+    CHECK(waitUntil([&](){return finished == 4;}, 30000));
+    iom.stop();
+    CHECK(numbers_got == COUNT && number_sum == (long)COUNT * (COUNT + 1) / 2);
+    CHECK(words_got == COUNT);
+    CHECK(out_got == COUNT && out_sum == (long)COUNT * (COUNT + 1) / 2);
+}
+
+int main()
+{
+    for(size_t capacity : {0, 1, 4, 64})
+    {
+	mpmcStress(capacity);
+    }
+    selectTimeout();
+    closeWhileParked(0);
+    closeWhileParked(2);
+    unbufferedTrySend();
+    selectMixed();
+    printf("channel_test passed\n");
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ - File Name: deadline_test.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Thu 05 Nov 2026 02:18:36 PM CST
+ */
+
+// waitEvent的就绪与超时竞争：另一个线程正好在截止时间前后写入数据，
+// 协程只能被恢复一次，EVENT_READY时数据一定可读，EVENT_TIMEOUT之后fd上的等待已经撤掉、可以重新等待，
+// 结束后截止时间堆和等待中的事件都为空
+#include "ioscheduler.h"
+#include "test_util.h"
+#include <atomic>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace Hourglass;
+
+static const int ROUNDS = 400;
+
+static int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void run(bool persistent)
+{
+    int sv[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    CHECK(fcntl(sv[0], F_SETFL, O_NONBLOCK) == 0);
+    IOManager iom(2, false, "deadline_test");
+    iom.setPersistentEvents(persistent);
+    // armed: 第几轮的截止时间已经发布；writing: 第几轮的数据开始写入（在write之前发布）
+    std::atomic<int> armed{0}, writing{0}, resumed{0}, ready{0}, timeouts{0};
+    std::atomic<int64_t> deadline_ns{0};
+    std::atomic<bool> finished{false};
+    std::thread writer([&]()
+    {
+	for(int round = 1;round <= ROUNDS;round++)
+	{
+	    while(armed.load() < round)
+	    {
+		std::this_thread::yield();
+	    }
+	    // 在截止时间前后100us之内写入
+	    int64_t at = deadline_ns.load() + (round % 11 - 5) * 20000;
+	    while(nowNs() < at)
+	    {
+		std::this_thread::yield();
+	    }
+	    writing = round;
+	    CHECK(write(sv[1], "x", 1) == 1);
+	}
+    });
+    iom.schedulerLock([&]()
+    {
+	for(int round = 1;round <= ROUNDS;round++)
+	{
+	    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(200);
+	    deadline_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+	    armed = round;
+	    int rt = iom.waitEvent(sv[0], IOManager::READ, deadline);
+	    resumed++;
+	    CHECK(rt == IOManager::EVENT_READY || rt == IOManager::EVENT_TIMEOUT);
+	    char c;
+	    if(rt == IOManager::EVENT_READY)
+	    {
+		ready++;
+		// 就绪一定是因为这一轮的写入
+		CHECK(writing.load() == round);
+		CHECK(recv(sv[0], &c, 1, 0) == 1);
+	    }
+	    else
+	    {
+		timeouts++;
+		CHECK(std::chrono::steady_clock::now() >= deadline);
+		// 超时之后等待已经从fd上撤掉，可以不带截止时间重新等待这一轮的数据
+		CHECK(iom.waitEvent(sv[0], IOManager::READ) == IOManager::EVENT_READY);
+		CHECK(recv(sv[0], &c, 1, 0) == 1);
+	    }
+	    CHECK(recv(sv[0], &c, 1, 0) == -1 && errno == EAGAIN);
+	}
+	finished = true;
+    });
+    CHECK(waitUntil([&](){return finished.load();}, 60000));
+    writer.join();
+    MetricsSnapshot metrics = iom.getMetrics();
+    CHECK(metrics.sum("hourglass_event_deadlines") == 0);
+    CHECK(metrics.sum("hourglass_pending_events") == 0);
+    iom.stop();
+    CHECK(resumed == ROUNDS && ready + timeouts == ROUNDS);
+    printf("persistent=%d ready=%d timeout=%d\n", persistent, ready.load(), timeouts.load());
+    close(sv[0]);
+    close(sv[1]);
+}
+
+int main()
+{
+    run(false);
+    run(true);
+    printf("deadline_test passed\n");
+    return 0;
+}
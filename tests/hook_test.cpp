@@ -0,0 +1,102 @@
+/*
+ - File Name: hook_test.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Wed 04 Nov 2026 10:16:24 AM CST
+ */
+
+// 系统调用hook与协程迁移：hook接管的socket是非阻塞的，协程在hooked usleep之后可能在另一个线程上恢复，
+// 之后的阻塞recv不能把EAGAIN返回给用户
+// per-iom:    IOManager::setHookEnable，所有工作线程都开启
+// per-thread: 只在协程开始时set_hook_enable，迁移到的线程可能没有开启，由poll保持阻塞语义
+#include "ioscheduler.h"
+#include "hook.h"
+#include "test_util.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace Hourglass;
+
+static const int CLIENTS = 32;
+
+static void run(bool per_iom)
+{
+    IOManager iom(4, false, "hook_test");
+    iom.setHookEnable(per_iom);
+    std::atomic<int> port{0}, served{0}, received{0}, errors{0};
+    iom.schedulerLock([&]()
+    {
+	set_hook_enable(true);
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	CHECK(bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+	CHECK(listen(listen_fd, CLIENTS) == 0);
+	CHECK(getsockname(listen_fd, (sockaddr*)&addr, &len) == 0);
+	port = ntohs(addr.sin_port);
+	for(int i = 0;i < CLIENTS;i++)
+	{
+	    int fd = accept(listen_fd, nullptr, nullptr);
+	    CHECK(fd >= 0);
+	    CHECK(send(fd, "x", 1, 0) == 1);
+	    iom.schedulerLock([fd, &served]()
+	    {
+		set_hook_enable(true);
+		// 等客户端读完再关闭
+		char c;
+		recv(fd, &c, 1, 0);
+		close(fd);
+		served++;
+	    });
+	}
+	close(listen_fd);
+    });
+    CHECK(waitUntil([&](){return port.load() != 0;}));
+    for(int i = 0;i < CLIENTS;i++)
+    {
+	iom.schedulerLock([&, i]()
+	{
+	    set_hook_enable(true);
+	    int fd = socket(AF_INET, SOCK_STREAM, 0);
+	    sockaddr_in addr;
+	    memset(&addr, 0, sizeof(addr));
+	    addr.sin_family = AF_INET;
+	    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	    addr.sin_port = htons(port);
+	    CHECK(connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+	    // 挂起之后可能在另一个线程上恢复
+	    usleep(1000 + i * 100);
+	    char c = 0;
+	    ssize_t n = recv(fd, &c, 1, 0);
+	    if(n != 1 || c != 'x')
+	    {
+		fprintf(stderr, "recv returned %zd: %s\n", n, n < 0 ? strerror(errno) : "");
+		errors++;
+	    }
+	    else
+	    {
+		received++;
+	    }
+	    CHECK(send(fd, "y", 1, 0) == 1);
+	    close(fd);
+	});
+    }
+    CHECK(waitUntil([&](){return received + errors == CLIENTS && served == CLIENTS;}));
+    iom.stop();
+    CHECK(errors == 0);
+}
+
+int main()
+{
+    run(true);
+    run(false);
+    printf("hook_test passed\n");
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ - File Name: priority_test.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Tue 03 Nov 2026 07:52:33 PM CST
+ */
+
+// 所有线程都在忙时提交的HIGH任务：调度是协作式的，不会抢占正在运行的任务，
+// 时延上限是第一个线程的当前任务让出或结束的时间，之后它先于更早排队的NORMAL任务执行
+#include "scheduler.h"
+#include "test_util.h"
+#include <atomic>
+
+using namespace Hourglass;
+
+static const int NORMAL_TASKS = 16;
+
+int main()
+{
+    Scheduler scheduler(2, false, "priority_test");
+    scheduler.start();
+    std::atomic<bool> release[2] = {{false}, {false}};
+    std::atomic<int> busy{0}, normal_done{0}, normal_before_high{-1};
+    std::atomic<bool> high_started{false};
+    for(int i = 0;i < 2;i++)
+    {
+	scheduler.schedulerLock([&busy, &release, i]()
+	{
+	    busy++;
+	    while(!release[i])
+	    {
+	    }
+	});
+    }
+    CHECK(waitUntil([&](){return busy.load() == 2;}));
+    for(int i = 0;i < NORMAL_TASKS;i++)
+    {
+	scheduler.schedulerLock([&normal_done](){normal_done++;});
+    }
+    scheduler.schedulerPriority([&]()
+    {
+	normal_before_high = normal_done.load();
+	high_started = true;
+    }, Scheduler::HIGH);
+
+    // 两个线程都没有让出，HIGH任务不会开始
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!high_started);
+    CHECK(normal_done == 0);
+
+    // 第一个线程空出来后，HIGH任务先于所有排队的NORMAL任务执行
+    release[0] = true;
+    CHECK(waitUntil([&](){return high_started.load();}));
+    CHECK(normal_before_high == 0);
+    release[1] = true;
+    CHECK(waitUntil([&](){return normal_done.load() == NORMAL_TASKS;}));
+    scheduler.stop();
+    printf("priority_test passed\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ - File Name: reactor_test.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Tue 03 Nov 2026 02:08:47 PM CST
+ */
+
+// 每线程reactor模式与共享栈协程：等待的fd属于其他线程的reactor时，协程仍要回到自己绑定的线程上恢复．
+// use_caller时主线程的epoll只在stop()中被等待，fd不能分给它，否则事件在stop()之前都不会触发
+#include "ioscheduler.h"
+#include "thread.h"
+#include "test_util.h"
+#include <atomic>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace Hourglass;
+
+static const int COROUTINES = 64;
+
+static void run(IOManager::ReactorMode mode, bool use_caller)
+{
+    IOManager iom(4, use_caller, "reactor_test", TimerManager::SET, IOManager::EPOLL, mode);
+    std::vector<int> fds(COROUTINES * 2);
+    std::atomic<int> fired{0};
+    // 每隔一对多占一个fd，让等待的fd号覆盖所有的余数，散列能落到每一个reactor上
+    std::vector<int> spacers;
+    for(int i = 0;i < COROUTINES;i++)
+    {
+	if(i % 2)
+	{
+	    spacers.push_back(open("/dev/null", O_RDONLY));
+	}
+	CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, &fds[i * 2]) == 0);
+	// 先在工作线程之外注册一次，fd按散列分到某个reactor，与之后等待它的协程所在的线程无关
+	CHECK(iom.addEvent(fds[i * 2], IOManager::WRITE, [&fired](){fired++;}) == 0);
+    }
+    CHECK(waitUntil([&](){return fired.load() == COROUTINES;}));
+
+    std::atomic<int> waiting{0}, finished{0}, moved{0};
+    for(int i = 0;i < COROUTINES;i++)
+    {
+	int fd = fds[i * 2];
+	iom.schedulerLock([&iom, &waiting, &finished, &moved, fd]()
+	{
+	    int before = Thread::GetThreadID();
+	    CHECK(iom.addEvent(fd, IOManager::READ) == 0);
+	    waiting++;
+	    Coroutine::getCoroutine()->yield();
+	    if(Thread::GetThreadID() != before)
+	    {
+		moved++;
+	    }
+	    char c;
+	    CHECK(read(fd, &c, 1) == 1);
+	    finished++;
+	}, -1, Coroutine::SHARED_STACK);
+    }
+    CHECK(waitUntil([&](){return waiting.load() == COROUTINES;}));
+    for(int i = 0;i < COROUTINES;i++)
+    {
+	CHECK(write(fds[i * 2 + 1], "x", 1) == 1);
+    }
+    CHECK(waitUntil([&](){return finished.load() == COROUTINES;}));
+    iom.stop();
+    CHECK(moved == 0);
+    for(int fd : fds)
+    {
+	close(fd);
+    }
+    for(int fd : spacers)
+    {
+	close(fd);
+    }
+}
+
+int main()
+{
+    run(IOManager::THREAD_REACTOR, false);
+    run(IOManager::HASH_REACTOR, false);
+    run(IOManager::THREAD_REACTOR, true);
+    run(IOManager::HASH_REACTOR, true);
+    printf("reactor_test passed\n");
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ - File Name: sync_test.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Tue 03 Nov 2026 10:31:05 AM CST
+ */
+
+// 同步原语的超时路径：超时的等待者要从队列中删除；普通Scheduler上带超时等待要报错而不是永远挂起
+#include "ioscheduler.h"
+#include "sync.h"
+#include "test_util.h"
+#include <atomic>
+#include <stdexcept>
+
+using namespace Hourglass;
+
+static const int ROUNDS = 200;
+
+// 协程中反复wait_for超时，队列中不能留下等待者
+static void conditionTimeoutInCoroutine()
+{
+    Mutex mutex;
+    ConditionVariable cond;
+    std::atomic<int> timeouts{0};
+    std::atomic<bool> finished{false};
+    size_t max_waiters = 0;
+    IOManager iom(2, false, "sync_test");
+    iom.schedulerLock([&]()
+    {
+	for(int i = 0;i < ROUNDS;i++)
+	{
+	    std::unique_lock<Mutex> lock(mutex);
+	    if(!cond.wait_for(lock, std::chrono::microseconds(100)))
+	    {
+		timeouts++;
+	    }
+	    max_waiters = std::max(max_waiters, cond.waiterCount());
+	}
+	finished = true;
+    });
+    CHECK(waitUntil([&](){return finished.load();}));
+    iom.stop();
+    CHECK(timeouts == ROUNDS);
+    CHECK(max_waiters == 0);
+    CHECK(cond.waiterCount() == 0);
+    // 队列清空后notify不会唤醒任何东西
+    cond.notify_one();
+    CHECK(cond.waiterCount() == 0);
+}
+
+// 不在调度器中时阻塞线程等待，超时同样要删除
+static void conditionTimeoutInThread()
+{
+    Mutex mutex;
+    ConditionVariable cond;
+    for(int i = 0;i < ROUNDS;i++)
+    {
+	std::unique_lock<Mutex> lock(mutex);
+	CHECK(!cond.wait_for(lock, std::chrono::microseconds(50)));
+	CHECK(cond.waiterCount() == 0);
+    }
+}
+
+// 超时与notify交错时，被唤醒的等待者也不能留在队列中
+static void conditionTimeoutWithNotify()
+{
+    Mutex mutex;
+    ConditionVariable cond;
+    std::atomic<bool> finished{false};
+    IOManager iom(2, false, "sync_test");
+    iom.schedulerLock([&]()
+    {
+	for(int i = 0;i < ROUNDS;i++)
+	{
+	    std::unique_lock<Mutex> lock(mutex);
+	    cond.wait_for(lock, std::chrono::microseconds(i % 3 == 0 ? 0 : 200));
+	}
+	finished = true;
+    });
+    while(!finished)
+    {
+	cond.notify_one();
+	std::this_thread::sleep_for(std::chrono::microseconds(150));
+    }
+    iom.stop();
+    CHECK(cond.waiterCount() == 0);
+}
+
+// 普通Scheduler没有定时器，带超时的等待抛出std::logic_error，不带超时的照常工作
+static void timedWaitOnPlainScheduler()
+{
+    Mutex mutex;
+    ConditionVariable cond;
+    Semaphore sem(0);
+    WaitGroup group;
+    group.add(1);
+    std::atomic<int> thrown{0};
+    std::atomic<bool> finished{false};
+    Scheduler scheduler(2, false, "sync_test");
+    scheduler.start();
+    scheduler.schedulerLock([&]()
+    {
+	try
+	{
+	    std::unique_lock<Mutex> lock(mutex);
+	    cond.wait_for(lock, std::chrono::milliseconds(1));
+	}
+	catch(const std::logic_error&)
+	{
+	    thrown++;
+	}
+	try
+	{
+	    sem.try_acquire_for(std::chrono::milliseconds(1));
+	}
+	catch(const std::logic_error&)
+	{
+	    thrown++;
+	}
+	try
+	{
+	    group.wait_for(std::chrono::milliseconds(1));
+	}
+	catch(const std::logic_error&)
+	{
+	    thrown++;
+	}
+	std::unique_lock<Mutex> lock(mutex);
+	try
+	{
+	    // 锁已经被自己持有，只能进入等待
+	    mutex.try_lock_for(std::chrono::milliseconds(1));
+	}
+	catch(const std::logic_error&)
+	{
+	    thrown++;
+	}
+	finished = true;
+    });
+    CHECK(waitUntil([&](){return finished.load();}));
+    scheduler.stop();
+    CHECK(thrown == 4);
+    CHECK(cond.waiterCount() == 0);
+}
+
+int main()
+{
+    conditionTimeoutInCoroutine();
+    conditionTimeoutInThread();
+    conditionTimeoutWithNotify();
+    timedWaitOnPlainScheduler();
+    printf("sync_test passed\n");
+    return 0;
+}
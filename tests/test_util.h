@@ -0,0 +1,42 @@
+/*
+ - File Name: test_util.h
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Tue 03 Nov 2026 10:12:40 AM CST
+ */
+
+#ifndef _TEST_UTIL_H_
+#define _TEST_UTIL_H_
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+// 测试程序以RelWithDebInfo构建时assert不生效，失败时用CHECK打印位置并以非0退出
+#define CHECK(cond) \
+    do \
+    { \
+	if(!(cond)) \
+	{ \
+	    fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+	    exit(1); \
+	} \
+    } while(0)
+
+// 等待pred成立，超过timeout_ms毫秒返回false
+template <class Predicate>
+static bool waitUntil(Predicate pred, int timeout_ms = 10000)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while(!pred())
+    {
+	if(std::chrono::steady_clock::now() > deadline)
+	{
+	    return false;
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,56 @@
+/*
+ - File Name: uring_test.cpp
+ - Author: YXC
+ - Mail: 2395611610@qq.com
+ - Created Time: Tue 03 Nov 2026 04:26:19 PM CST
+ */
+
+// io_uring后端：所有工作线程都在忙时，已经排队的SQE也要被提交，不能等到某个线程进入idle
+#include "ioscheduler.h"
+#include "test_util.h"
+#include <atomic>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace Hourglass;
+
+int main()
+{
+    IOManager iom(1, false, "uring_test", TimerManager::SET, IOManager::IO_URING);
+    if(iom.getIOBackend() != IOManager::IO_URING)
+    {
+	// 内核不支持io_uring，已经退回EPOLL
+	iom.stop();
+	printf("uring_test skipped\n");
+	return 0;
+    }
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    std::atomic<bool> release{false};
+    std::atomic<ssize_t> written{0};
+    iom.schedulerLock([&]()
+    {
+	// 写请求排队让出后，唯一的工作线程接着执行这个一直不让出的任务，不会进入idle
+	Scheduler::GetThis()->schedulerLock([&release]()
+	{
+	    while(!release)
+	    {
+	    }
+	});
+	written = iom.asyncWrite(fds[1], "x", 1);
+    });
+    pollfd pfd;
+    pfd.fd = fds[0];
+    pfd.events = POLLIN;
+    int ready = poll(&pfd, 1, 5000);
+    release = true;
+    CHECK(ready == 1);
+    char c;
+    CHECK(read(fds[0], &c, 1) == 1 && c == 'x');
+    CHECK(waitUntil([&](){return written.load() == 1;}));
+    iom.stop();
+    close(fds[0]);
+    close(fds[1]);
+    printf("uring_test passed\n");
+    return 0;
+}